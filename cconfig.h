@@ -17,6 +17,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #ifndef CCONFDEF
 #define CCONFDEF static inline
@@ -27,6 +29,29 @@
 
 #define CCONF_COMMENT '#'
 #define CCONF_STRING_SIZE(s) (*(((CConfStringSize*)s) - 1))
+#define CCONF_ERROR_SIZE 1024
+
+// Default size in bytes after which a journal is compacted
+#ifndef CCONF_JOURNAL_THRESHOLD
+#define CCONF_JOURNAL_THRESHOLD (1 << 20)
+#endif
+
+// Maximum amount of threads registered as readers of a CConfSnapshots
+#ifndef CCONF_SNAPSHOT_READERS
+#define CCONF_SNAPSHOT_READERS 64
+#endif
+
+// Default time in milliseconds without changes after which a watched file
+// is reloaded
+#ifndef CCONF_WATCH_DEBOUNCE
+#define CCONF_WATCH_DEBOUNCE 50
+#endif
+
+// Snapshots and live fields are only available with the atomics of GCC,
+// Clang or MSVC, or with CCONF_NO_THREADS when a single thread uses them
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER) || defined(CCONF_NO_THREADS)
+#define CCONF_HAS_ATOMICS
+#endif
 
 #define _CCONF_RETURN_DEFER(s) do { status = (s); goto defer; } while(0);
 
@@ -66,6 +91,10 @@ static inline void Name##_free(Name *arr) {                              \
 }
 
 _CCONF_CREATE_DA(size_t, _CConf_size_t_da)
+_CCONF_CREATE_DA(char, _CConfOutput)
+
+// Growable buffer filled by cconf_serialize(), `items` is not NULL terminated
+typedef _CConfOutput CConfBuffer;
 
 typedef char CConfString;
 typedef uint32_t CConfStringSize;
@@ -77,7 +106,14 @@ typedef enum {
 	CCONF_STATUS_FTELL,
 	CCONF_STATUS_FCLOSE,
 	CCONF_STATUS_FREAD,
-	CCONF_STATUS_MALLOC
+	CCONF_STATUS_MALLOC,
+	CCONF_STATUS_SCHEMA,
+	CCONF_STATUS_PARSE,
+	CCONF_STATUS_EOF,
+	CCONF_STATUS_FWRITE,
+	CCONF_STATUS_FSYNC,
+	CCONF_STATUS_WATCH,
+	CCONF_STATUS_UNSUPPORTED
 } CCONF_STATUS;
 
 typedef enum {
@@ -102,7 +138,29 @@ typedef union {
 
 _CCONF_CREATE_DA(CConfAs, CConfAs_da)
 
+// Open addressing table with linear probing. Each slot holds the index of
+// an item stored elsewhere plus one, and 0 marks an empty slot.
+typedef struct {
+	uint32_t* slots;
+	size_t mask;
+} _CConfHashTable;
+
+typedef struct {
+	_CConfHashTable table; // Element indices
+
+	// State of the array when the index was built
+	const CConfAs* items;
+	size_t count;
+} _CConfArrayIndex;
+
 typedef struct {
+	int64_t start;
+	int64_t end;
+	int64_t startl;
+	int64_t endl;
+} CConfSpan;
+
+typedef struct CConfField {
 	CConfString* fieldname;
 
 	union {
@@ -110,24 +168,289 @@ typedef struct {
 		CConfAs_da arr;
 	};
 
+	_CConfArrayIndex* index;
+
 	int64_t startl;
 	int64_t endl;
+
+	// Byte offsets, from the start of the first line
+	// up to the newline after the field (included)
+	int64_t start;
+	int64_t end;
+	size_t pos; // Position inside CConfFile.values
+
 	uint8_t type; // enum CCONF_TYPE
 	bool dirty;
+	bool journaled; // The value is only inside the journal
+	bool removed; // Tombstone, freed by a later write
+
+	// Field after which a field that was not written yet is inserted
+	struct CConfField* anchor;
+
+	// Original text of the value, relative to `start` and `startl`,
+	// all set to -1 while the field is not inside the file
+	CConfSpan value;
+
+	// Bumped by every live update, see cconf_field_generation()
+	uint32_t generation;
+	// Threads copying the string value through cconf_field_string()
+	uint32_t readers;
 } CConfField;
 
 _CCONF_CREATE_DA(CConfField*, pCConfField_da)
 
+// String value replaced while it could still be read by another thread
+typedef struct {
+	CConfField* field;
+	CConfString* str;
+} _CConfRetired;
+
+_CCONF_CREATE_DA(_CConfRetired, _CConfRetired_da)
+
+typedef enum {
+	CCONF_SCHEMA_REQUIRED = 1 << 0,
+	CCONF_SCHEMA_RANGE = 1 << 1,
+	CCONF_SCHEMA_LENGTH = 1 << 2,
+	CCONF_SCHEMA_ENUM = 1 << 3,
+	CCONF_SCHEMA_COUNT = 1 << 4
+} CCONF_SCHEMA_FLAG;
+
+typedef enum {
+	CCONF_SCHEMA_ERROR_NONE = 0,
+	CCONF_SCHEMA_ERROR_UNKNOWN,
+	CCONF_SCHEMA_ERROR_TYPE,
+	CCONF_SCHEMA_ERROR_RANGE,
+	CCONF_SCHEMA_ERROR_LENGTH,
+	CCONF_SCHEMA_ERROR_ENUM,
+	CCONF_SCHEMA_ERROR_COUNT,
+	CCONF_SCHEMA_ERROR_MISSING
+} CCONF_SCHEMA_ERROR;
+
+typedef struct {
+	const char* fieldname;
+	uint8_t type;  // enum CCONF_TYPE
+	uint8_t flags; // enum CCONF_SCHEMA_FLAG
+
+	// CCONF_SCHEMA_RANGE (applied to every element of arrays)
+	int64_t min_num;
+	int64_t max_num;
+	double min_dec;
+	double max_dec;
+
+	// CCONF_SCHEMA_LENGTH (applied to every element of arrays)
+	size_t min_len;
+	size_t max_len;
+
+	// CCONF_SCHEMA_ENUM (applied to every element of arrays)
+	const char** values;
+	size_t values_count;
+
+	// CCONF_SCHEMA_COUNT
+	size_t min_count;
+	size_t max_count;
+} CConfSchemaRule;
+
+typedef struct {
+	CConfString* fieldname;
+	uint8_t type;
+	uint8_t flags;
+
+	// Numbers, decimals and string lengths share the same bounds
+	union {
+		int64_t num;
+		double dec;
+	} lo, hi;
+
+	size_t min_count;
+	size_t max_count;
+
+	size_t enum_start;
+	size_t enum_count;
+} _CConfSchemaEntry;
+
+typedef struct {
+	_CConfSchemaEntry* entries;
+	size_t count;
+
+	_CConfHashTable table; // Entry indices
+
+	CConfString** enums;
+	size_t required;
+	bool strict;
+} CConfSchema;
+
+typedef struct {
+	uint8_t error; // enum CCONF_SCHEMA_ERROR
+	size_t rule;
+	size_t element;
+	size_t row;
+	size_t col;
+} CConfSchemaViolation;
+
+typedef void (CCONF_HANDLER)(
+	CConfField* field,
+	void* user
+);
+
+typedef bool (CCONF_ELEMENT_HANDLER)(
+	CConfField* field,
+	size_t index,
+	CConfAs* value,
+	void* user
+);
+
+typedef enum {
+	CCONF_SELECT_SKIP = 0,
+	CCONF_SELECT_LOAD,
+	CCONF_SELECT_LAST,
+	CCONF_SELECT_STOP
+} CCONF_SELECT;
+
+typedef uint8_t (CCONF_SELECTOR)(
+	const char* name,
+	size_t len,
+	void* user
+);
+
+typedef enum {
+	CCONF_FLAG_INDEX_ARRAYS = 1 << 0,
+	CCONF_FLAG_PRECOUNT_ARRAYS = 1 << 1,
+	CCONF_FLAG_KEEP_BUFFER = 1 << 2,
+	CCONF_FLAG_COPY_RANGE = 1 << 3,
+	CCONF_FLAG_WRITE_IN_PLACE = 1 << 4,
+	CCONF_FLAG_ATOMIC_WRITE = 1 << 5,
+	CCONF_FLAG_JOURNAL = 1 << 6,
+	CCONF_FLAG_REBASE = 1 << 7,
+	CCONF_FLAG_NO_EXIT = 1 << 8
+} CCONF_FLAG;
+
+// Fenwick trees holding the size changes of the fields written since
+// the last rebuild, so that the spans of the following fields can be
+// computed without updating them one by one
+typedef struct {
+	int64_t* bytes;
+	int64_t* lines;
+	size_t count;
+} _CConfSpans;
+
+// Identifies the contents of a file on disk
+typedef struct {
+	int64_t size;
+	int64_t mtime;
+	int64_t dev;
+	int64_t ino;
+
+	// Time at which the stamp was taken, changes made within the same
+	// second as `mtime` can only be detected through `hash`
+	int64_t taken;
+	uint64_t hash;
+	bool hashed;
+} _CConfStamp;
+
 typedef struct {
 	char* filepath;
 	pCConfField_da values;
+	uint32_t flags; // enum CCONF_FLAG
+
+	CCONF_ELEMENT_HANDLER* element_handler;
+	CCONF_SELECTOR* selector;
+
+	const CConfSchema* schema;
+	CConfSchemaViolation violation;
+
+	// Contents of the file as of the last load or write,
+	// only kept with CCONF_FLAG_KEEP_BUFFER
+	char* data;
+	size_t len;
+	_CConf_size_t_da newlines;
+
+	// Stamp and newlines of the file as of the last load or write
+	_CConfStamp stamp;
+	size_t lines;
+
+	// Writes are coalesced until `commit_interval` milliseconds passed since
+	// the first deferred one, or until `commit_threshold` fields are dirty
+	uint32_t commit_interval;
+	size_t commit_threshold;
+	bool pending;
+	int64_t pending_since;
+
+	// Journal of the changes not yet compacted into the file,
+	// with CCONF_FLAG_JOURNAL
+	size_t journal_threshold;
+	size_t journal_size;
+	bool journal_partial;
+
+	_CConfSpans spans;
+
+	// Amount of removed fields still inside `values`
+	size_t removed;
+
+	// Strings replaced by cconf_field_set_string() during a read
+	_CConfRetired_da retired;
 } CConfFile;
 
-typedef void (CCONF_HANDLER)(
-	CConfField* field,
+typedef struct _CConfSnapshot {
+	CConfFile file;
+
+	// Epoch at which the snapshot was replaced
+	uint64_t retired;
+	struct _CConfSnapshot* next;
+} _CConfSnapshot;
+
+// Each reader is on its own cache line, as it is written by a different thread
+typedef struct {
+	uint64_t epoch; // 0 while offline
+	uint8_t used;
+	char padding[64 - sizeof(uint64_t) - sizeof(uint8_t)];
+} _CConfSnapshotReader;
+
+// Immutable snapshots of a configuration file, replaced by reloads while
+// readers keep using them without locks
+typedef struct {
+	_CConfSnapshot* current;
+	_CConfSnapshot* retired;
+	uint64_t epoch;
+
+	_CConfSnapshotReader readers[CCONF_SNAPSHOT_READERS];
+} CConfSnapshots;
+
+// Takes the ownership of `cconf`, which must be freed or published
+typedef void (CCONF_RELOAD_HANDLER)(
+	CConfFile* cconf,
+	const char* filepath,
+	CCONF_STATUS status,
 	void* user
 );
 
+typedef struct {
+	char* filepath;
+	const char* name; // Inside `filepath`, after the last slash
+	int wd; // Watch of the directory
+
+	bool pending;
+	int64_t deadline;
+} _CConfWatch;
+
+_CCONF_CREATE_DA(_CConfWatch, _CConfWatch_da)
+
+// Reloads configuration files when they change, with inotify
+typedef struct {
+	int fd;
+	uint32_t debounce;
+
+	// Applied to every reloaded file
+	uint32_t flags; // enum CCONF_FLAG
+	const CConfSchema* schema;
+	CCONF_HANDLER* field_handler;
+
+	CCONF_RELOAD_HANDLER* handler;
+	void* user;
+
+	_CConfWatch_da watches;
+	int wake[2]; // Pipe written by cconf_watcher_stop()
+} CConfWatcher;
+
 typedef enum { // uint16_t
 	_CCONF_LEXER_STRING = 1 << 0,
 	_CCONF_LEXER_LITERAL = 1 << 1,
@@ -166,6 +489,62 @@ typedef struct {
 	char* data;
 } _CConfToken;
 
+typedef enum {
+	_CCONF_PARSE_FIELD = 0,
+	_CCONF_PARSE_EOF,
+	_CCONF_PARSE_SYNTAX,
+	_CCONF_PARSE_SCHEMA
+} _CCONF_PARSE;
+
+typedef struct {
+	_CConfLexer lexer;
+
+	uint32_t flags; // enum CCONF_FLAG
+	CCONF_ELEMENT_HANDLER* element_handler;
+	void* user;
+
+	CCONF_SELECTOR* selector;
+	void* selector_user;
+	bool stopped;
+
+	struct _CConfJournal* journal;
+
+	const CConfSchema* schema;
+	CConfSchemaViolation* violation;
+	uint8_t* seen;
+
+	// Set on _CCONF_PARSE_SYNTAX
+	uint16_t expected;
+	_CConfToken got;
+} _CConfParser;
+
+typedef struct {
+	size_t row;
+	size_t col;
+	uint16_t expected; // _CCONF_LEXER_TOKEN bitmask
+	uint16_t got;      // _CCONF_LEXER_TOKEN
+} CConfDiagnostic;
+
+typedef struct {
+	CConfDiagnostic* items;
+	size_t capacity;
+	size_t count;
+	size_t total;
+} CConfDiagnostics;
+
+typedef struct {
+	uint32_t flags; // enum CCONF_FLAG
+	CCONF_ELEMENT_HANDLER* element_handler;
+	void* user;
+
+	const CConfSchema* schema;
+	CConfSchemaViolation violation;
+
+	_CConfParser parser;
+	char* data;
+	bool started;
+} CConfReader;
+
 // String functions
 CCONFDEF CConfString* cconf_string_from_size(CConfStringSize len);
 CCONFDEF CConfString* cconf_string_new(const char* s);
@@ -183,12 +562,255 @@ CCONFDEF CCONF_STATUS cconf_load(
 	void* user
 );
 
+CCONFDEF CCONF_STATUS cconf_load_keys(
+	CConfFile* cconf,
+	const char* filepath,
+	const char* const* keys,
+	size_t count,
+	CCONF_HANDLER* handler,
+	void* user
+);
+
+CCONFDEF CCONF_STATUS cconf_reload(CConfFile* cconf, CCONF_HANDLER* handler, void* user);
+
 CCONFDEF CConfField *cconf_field_new(CConfString *fieldname, uint8_t type);
+CCONFDEF void cconf_field_clear(CConfField* field);
 CCONFDEF void cconf_append_field(CConfFile* cconf, CConfField* field);
+CCONFDEF void cconf_insert_field(CConfFile* cconf, CConfField* after, CConfField* field);
+CCONFDEF void cconf_remove_field(CConfFile* cconf, CConfField* field);
+CCONFDEF CConfSpan cconf_field_span(CConfFile* cconf, CConfField* field);
 CCONFDEF CCONF_STATUS cconf_write(CConfFile* cconf);
+CCONFDEF CCONF_STATUS cconf_flush(CConfFile* cconf);
+CCONFDEF CCONF_STATUS cconf_journal_compact(CConfFile* cconf);
+CCONFDEF void cconf_serialize(CConfFile* cconf, CConfBuffer* buf);
+CCONFDEF CCONF_STATUS cconf_serialize_patched(CConfFile* cconf, CConfBuffer* buf);
+CCONFDEF void cconf_buffer_free(CConfBuffer* buf);
+
+// Schema functions
+CCONFDEF CCONF_STATUS cconf_schema_compile(
+	CConfSchema* schema,
+	const CConfSchemaRule* rules,
+	size_t count,
+	bool strict
+);
+CCONFDEF void cconf_schema_free(CConfSchema* schema);
+
+// Reader functions
+CCONFDEF CCONF_STATUS cconf_reader_open(CConfReader* reader, const char* filepath);
+CCONFDEF void cconf_reader_open_buffer(CConfReader* reader, const char* data, size_t len);
+CCONFDEF CCONF_STATUS cconf_reader_next(CConfReader* reader, CConfField* field);
+CCONFDEF void cconf_reader_format_error(CConfReader* reader, char* buf);
+CCONFDEF void cconf_reader_close(CConfReader* reader);
+
+// Validation functions
+CCONFDEF CCONF_STATUS cconf_validate(const char* filepath, CConfDiagnostics* diagnostics);
+CCONFDEF CCONF_STATUS cconf_validate_buffer(const char* data, size_t len, CConfDiagnostics* diagnostics);
+CCONFDEF void cconf_diagnostic_format(const CConfDiagnostic* diagnostic, char* buf);
+
+// Array functions
+CCONFDEF CCONF_STATUS cconf_array_index(CConfField* field);
+CCONFDEF void cconf_array_index_free(CConfField* field);
+CCONFDEF bool cconf_array_contains_string(CConfField* field, const char* s, size_t len);
+CCONFDEF bool cconf_array_contains_number(CConfField* field, int64_t num);
+
+#ifdef CCONF_HAS_ATOMICS
+// Live field functions
+CCONFDEF int64_t cconf_field_number(const CConfField* field);
+CCONFDEF double cconf_field_decimal(const CConfField* field);
+CCONFDEF bool cconf_field_boolean(const CConfField* field);
+CCONFDEF size_t cconf_field_string(CConfField* field, char* buf, size_t size);
+CCONFDEF uint32_t cconf_field_generation(const CConfField* field);
+CCONFDEF void cconf_field_set_number(CConfField* field, int64_t num);
+CCONFDEF void cconf_field_set_decimal(CConfField* field, double dec);
+CCONFDEF void cconf_field_set_boolean(CConfField* field, bool boolean);
+CCONFDEF void cconf_field_set_string(CConfFile* cconf, CConfField* field, const char* s, size_t len);
+
+// Snapshot functions
+CCONFDEF void cconf_snapshots_init(CConfSnapshots* snapshots);
+CCONFDEF void cconf_snapshots_free(CConfSnapshots* snapshots);
+CCONFDEF CCONF_STATUS cconf_snapshot_publish(CConfSnapshots* snapshots, CConfFile* cconf);
+CCONFDEF const CConfFile* cconf_snapshot_get(CConfSnapshots* snapshots);
+CCONFDEF size_t cconf_snapshot_register(CConfSnapshots* snapshots);
+CCONFDEF void cconf_snapshot_unregister(CConfSnapshots* snapshots, size_t reader);
+CCONFDEF void cconf_snapshot_quiescent(CConfSnapshots* snapshots, size_t reader);
+CCONFDEF void cconf_snapshot_offline(CConfSnapshots* snapshots, size_t reader);
+CCONFDEF size_t cconf_snapshot_reclaim(CConfSnapshots* snapshots);
+#endif // CCONF_HAS_ATOMICS
+
+// Watcher functions
+CCONFDEF CCONF_STATUS cconf_watcher_init(CConfWatcher* watcher, CCONF_RELOAD_HANDLER* handler, void* user);
+CCONFDEF CCONF_STATUS cconf_watcher_add(CConfWatcher* watcher, const char* filepath);
+CCONFDEF CCONF_STATUS cconf_watcher_process(CConfWatcher* watcher, int* timeout);
+CCONFDEF CCONF_STATUS cconf_watcher_run(CConfWatcher* watcher);
+CCONFDEF void cconf_watcher_stop(CConfWatcher* watcher);
+CCONFDEF void cconf_watcher_free(CConfWatcher* watcher);
 
 #ifdef CCONF_IMPLEMENTATION
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#endif
+
+// Files are written with raw system calls when available
+#ifdef _POSIX_VERSION
+#define _CCONF_POSIX
+#endif
+
+// ftruncate() is not declared by strict C99 builds
+#if defined(_CCONF_POSIX) && (defined(__APPLE__) || defined(_XOPEN_SOURCE) || \
+	(defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200112L))
+#define _CCONF_IN_PLACE
+#endif
+
+// Same for mkstemp(), fsync() and fchmod()
+#if defined(_CCONF_POSIX) && (defined(__APPLE__) || \
+	(defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L))
+#define _CCONF_ATOMIC
+#endif
+
+// flock() is declared regardless of the feature macros on these systems
+#if defined(_CCONF_POSIX) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#include <sys/file.h>
+#define _CCONF_LOCK
+#endif
+
+// Watched files are reloaded on inotify events
+#if defined(_CCONF_POSIX) && defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#define _CCONF_WATCH
+#endif
+
+// Snapshots and live fields are published with the atomic builtins of GCC
+// and Clang, which are also available to C99 builds, or with the
+// interlocked intrinsics of MSVC
+#if defined(__GNUC__) || defined(__clang__)
+#define _CCONF_LOAD(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define _CCONF_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define _CCONF_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define _CCONF_LOAD_VALUE(p, out) __atomic_load((p), (out), __ATOMIC_ACQUIRE)
+#define _CCONF_STORE_VALUE(p, v) __atomic_store((p), (v), __ATOMIC_RELEASE)
+#define _CCONF_EXCHANGE(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define _CCONF_INCREMENT(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define _CCONF_DECREMENT(p) __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define _CCONF_CLAIM(p) (!__atomic_test_and_set((p), __ATOMIC_ACQUIRE))
+#define _CCONF_RELEASE(p) __atomic_clear((p), __ATOMIC_RELEASE)
+#define _CCONF_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+
+// The interlocked intrinsics are full barriers, and they are picked by the
+// size of the operand, since C99 has no generic selection. Pointers go
+// through uintptr_t, and values of 8 bytes (CConfAs) through __int64.
+#define _CCONF_LOAD(p) _cconf_interlocked_load((p), sizeof(*(p)))
+#define _CCONF_LOAD_ACQUIRE(p) _CCONF_LOAD(p)
+#define _CCONF_STORE_RELEASE(p, v) _cconf_interlocked_store((p), sizeof(*(p)), (uint64_t)(v))
+#define _CCONF_LOAD_VALUE(p, out) _cconf_interlocked_load_value((p), (out), sizeof(*(p)))
+#define _CCONF_STORE_VALUE(p, v) _cconf_interlocked_store_value((p), (v), sizeof(*(p)))
+#define _CCONF_EXCHANGE(p, v) _cconf_interlocked_exchange((p), sizeof(*(p)), (uint64_t)(uintptr_t)(v))
+#define _CCONF_INCREMENT(p) _cconf_interlocked_add((p), sizeof(*(p)), 1)
+#define _CCONF_DECREMENT(p) _cconf_interlocked_add((p), sizeof(*(p)), -1)
+#define _CCONF_CLAIM(p) (_InterlockedExchange8((volatile char*)(p), 1) == 0)
+#define _CCONF_RELEASE(p) _InterlockedExchange8((volatile char*)(p), 0)
+#define _CCONF_FENCE() _cconf_interlocked_fence()
+
+static inline uint64_t _cconf_interlocked_load(const volatile void* p, size_t size) {
+	switch (size) {
+	case 1:
+		return (uint8_t)_InterlockedOr8((volatile char*)p, 0);
+	case 4:
+		return (uint32_t)_InterlockedOr((volatile long*)p, 0);
+	default:
+		return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)p, 0, 0);
+	}
+}
+
+static inline uint64_t _cconf_interlocked_exchange(volatile void* p, size_t size, uint64_t v) {
+	switch (size) {
+	case 1:
+		return (uint8_t)_InterlockedExchange8((volatile char*)p, (char)v);
+	case 4:
+		return (uint32_t)_InterlockedExchange((volatile long*)p, (long)v);
+	default: {
+		// _InterlockedExchange64 is not available to 32-bit builds
+		__int64 old = *(volatile __int64*)p;
+		__int64 seen;
+
+		while ((seen = _InterlockedCompareExchange64((volatile __int64*)p, (__int64)v, old)) != old) {
+			old = seen;
+		}
+
+		return (uint64_t)old;
+	}
+	}
+}
+
+static inline void _cconf_interlocked_store(volatile void* p, size_t size, uint64_t v) {
+	_cconf_interlocked_exchange(p, size, v);
+}
+
+static inline uint64_t _cconf_interlocked_add(volatile void* p, size_t size, int64_t delta) {
+	if (size == 4) {
+		return (uint32_t)(_InterlockedExchangeAdd((volatile long*)p, (long)delta) + (long)delta);
+	}
+
+	__int64 old = *(volatile __int64*)p;
+	__int64 seen;
+
+	while ((seen = _InterlockedCompareExchange64((volatile __int64*)p, old + delta, old)) != old) {
+		old = seen;
+	}
+
+	return (uint64_t)(old + delta);
+}
+
+static inline void _cconf_interlocked_load_value(const volatile void* p, void* out, size_t size) {
+	uint64_t v = _cconf_interlocked_load(p, size);
+	memcpy(out, &v, size);
+}
+
+static inline void _cconf_interlocked_store_value(volatile void* p, const void* v, size_t size) {
+	uint64_t value = 0;
+	memcpy(&value, v, size);
+	_cconf_interlocked_store(p, size, value);
+}
+
+static inline void _cconf_interlocked_fence(void) {
+	volatile long fence = 0;
+	_InterlockedOr(&fence, 0);
+}
+#else
+// Snapshots and live fields are only used by a single thread, or not
+// available at all, in which case fields are never read concurrently
+#define _CCONF_LOAD(p) (*(p))
+#define _CCONF_LOAD_ACQUIRE(p) (*(p))
+#define _CCONF_STORE_RELEASE(p, v) (*(p) = (v))
+#define _CCONF_LOAD_VALUE(p, out) (*(out) = *(p))
+#define _CCONF_STORE_VALUE(p, v) (*(p) = *(v))
+#define _CCONF_EXCHANGE(p, v) _cconf_exchange_ptr((void**)(p), (v))
+#define _CCONF_INCREMENT(p) (++*(p))
+#define _CCONF_DECREMENT(p) (--*(p))
+#define _CCONF_CLAIM(p) (*(p) ? false : (*(p) = 1, true))
+#define _CCONF_RELEASE(p) (*(p) = 0)
+#define _CCONF_FENCE() ((void)0)
+
+static inline void* _cconf_exchange_ptr(void** p, void* v) {
+	void* old = *p;
+	*p = v;
+	return old;
+}
+#endif
+
+// copy_file_range() needs _GNU_SOURCE and glibc 2.27
+#if defined(_CCONF_ATOMIC) && defined(__linux__) && defined(_GNU_SOURCE) && defined(__GLIBC__) && \
+	(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define _CCONF_COPY_RANGE
+#endif
+
 static inline uint8_t _cconf_popcnt(uint16_t tokens) {
 	uint8_t res = 0;
 
@@ -201,6 +823,95 @@ static inline uint8_t _cconf_popcnt(uint16_t tokens) {
 	return res;
 }
 
+// FNV-1a
+static inline uint32_t _cconf_hash(const char* s, size_t len) {
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (uint8_t)s[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+// Name looked up inside the tables indexed by name
+typedef struct {
+	const char* data;
+	size_t len;
+} _CConfName;
+
+// Whether the item at `index` matches `key`
+typedef bool (_CCONF_HASH_EQUAL)(const void* key, size_t index, const void* user);
+
+// Sizes the table for `count` items and empties it, keeping the load factor
+// at or below 50%. The slots are reused when the size does not change.
+static inline bool _cconf_hashtable_reset(_CConfHashTable* table, size_t count) {
+	size_t size = 2;
+
+	while (size < count * 2) {
+		size *= 2;
+	}
+
+	if (table->slots != NULL && table->mask + 1 == size) {
+		memset(table->slots, 0, size * sizeof(uint32_t));
+		return true;
+	}
+
+	free(table->slots);
+	table->slots = (uint32_t*)calloc(size, sizeof(uint32_t));
+	table->mask = size - 1;
+	return table->slots != NULL;
+}
+
+static inline void _cconf_hashtable_free(_CConfHashTable* table) {
+	free(table->slots);
+	table->slots = NULL;
+	table->mask = 0;
+}
+
+// Returns the slot of the first item that matches `key`, or the empty slot
+// that ends the probe sequence, where such an item would be added
+static inline size_t _cconf_hashtable_find(
+	const _CConfHashTable* table,
+	uint32_t hash,
+	const void* key,
+	_CCONF_HASH_EQUAL* equal,
+	const void* user
+) {
+	size_t slot = hash & table->mask;
+
+	while (table->slots[slot] != 0 && !equal(key, table->slots[slot] - 1, user)) {
+		slot = (slot + 1) & table->mask;
+	}
+
+	return slot;
+}
+
+// Adds an item after the ones that are already in the table, even if they
+// match it, so that they are found first
+static inline void _cconf_hashtable_add(_CConfHashTable* table, uint32_t hash, size_t index) {
+	size_t slot = hash & table->mask;
+
+	while (table->slots[slot] != 0) {
+		slot = (slot + 1) & table->mask;
+	}
+
+	table->slots[slot] = (uint32_t)(index + 1);
+}
+
+// Same as _cconf_hashtable_find, returning the index of the item or -1
+static inline int64_t _cconf_hashtable_get(
+	const _CConfHashTable* table,
+	uint32_t hash,
+	const void* key,
+	_CCONF_HASH_EQUAL* equal,
+	const void* user
+) {
+	size_t slot = _cconf_hashtable_find(table, hash, key, equal, user);
+	return (int64_t)table->slots[slot] - 1;
+}
+
 static inline void _cconf_token_format_line(_CConfToken* token, char* buf) {
 	sprintf(buf, "%zu:%zu", token->row + 1, token->col + 1);
 }
@@ -328,15 +1039,16 @@ static inline bool _cconf_lexer_prev(_CConfLexer* lexer, char* c) {
 static inline bool _cconf_lexer_skip_entire_line(_CConfLexer* lexer) {
 	char c = 0;
 	while (_cconf_lexer_next(lexer, &c) && c != '\n') {}
-	_cconf_lexer_prev(lexer, NULL);
-	_cconf_lexer_prev(lexer, NULL);
 
-	if (c == '\n') {
-		return true;
-	}
-	else {
+	// At the end of the file the lexer stays there, so that the rest
+	// of the comment is not read again by the next token
+	if (c != '\n') {
 		return false;
 	}
+
+	_cconf_lexer_prev(lexer, NULL);
+	_cconf_lexer_prev(lexer, NULL);
+	return true;
 }
 
 static inline bool _cconf_isspace(char c) {
@@ -384,13 +1096,19 @@ static inline _CConfToken _cconf_lexer_read_literal(_CConfLexer* lexer) {
 
 	_cconf_lexer_prev(lexer, NULL);
 
-	if (strncmp(&lexer->data[lexer->pos - len], "true", len) == 0) {
-		_CConfToken ret = _CCONF_TOKEN(sr, lexer->row, sc, sp, len, BOOLEAN);
-		return ret;
+	// Only the exact words are booleans, anything else (`tru`, `falsey`)
+	// is a literal, which is never a valid value
+	size_t word = 0;
 
+	while (sp + word < lexer->len && isalnum(lexer->data[sp + word])) {
+		word++;
 	}
-	else if (strncmp(&lexer->data[lexer->pos - len], "false", len) == 0) {
-		_CConfToken ret = _CCONF_TOKEN(sr, lexer->row, sc, sp, len, BOOLEAN);
+
+	if (
+		(word == 4 && memcmp(&lexer->data[sp], "true", 4) == 0) ||
+		(word == 5 && memcmp(&lexer->data[sp], "false", 5) == 0)
+	) {
+		_CConfToken ret = _CCONF_TOKEN(sr, lexer->row, sc, sp, word, BOOLEAN);
 		return ret;
 	}
 
@@ -407,15 +1125,20 @@ static inline _CConfToken _cconf_lexer_read_number(_CConfLexer* lexer) {
 	size_t len = 1;
 	bool sep_appeared = false;
 	bool has_digit = false;
+	bool eof = false;
 
 	_cconf_lexer_next(lexer, &current);
 
 	if (current == '-' || current == '+') {
-		_cconf_lexer_next(lexer, &current);
-		len++;
+		if (_cconf_lexer_next(lexer, &current)) {
+			len++;
+		}
+		else {
+			eof = true;
+		}
 	}
 
-	while (isdigit(current) || current == '.') {
+	while (!eof && (isdigit(current) || current == '.')) {
 		if (current == '.') {
 			if (sep_appeared) {
 				_CConfToken ret = _CCONF_TOKEN(sr, sr, sc, sp, 0, INVALID);
@@ -429,12 +1152,25 @@ static inline _CConfToken _cconf_lexer_read_number(_CConfLexer* lexer) {
 			has_digit = true;
 		}
 
-		_cconf_lexer_next(lexer, &current);
+		// The number ends right before the end of the file
+		if (!_cconf_lexer_next(lexer, &current)) {
+			eof = true;
+			break;
+		}
+
 		len++;
 	}
 
-	_cconf_lexer_prev(lexer, &current);
-	len--;
+	if (!eof) {
+		_cconf_lexer_prev(lexer, &current);
+		len--;
+	}
+	else if (isdigit(lexer->data[lexer->pos])) {
+		// The last character of the data is never lexed, but it is
+		// still a digit of the number
+		has_digit = true;
+		len++;
+	}
 
 	if (!has_digit) {
 		_CConfToken ret = _CCONF_TOKEN(sr, sr, sc, sp, 0, INVALID);
@@ -562,75 +1298,227 @@ static inline _CConfToken _cconf_lexer_next_token(_CConfLexer* lexer) {
 	return ret;
 }
 
-static inline CCONF_STATUS _cconf_read_entire_file(const char* filepath, size_t* len, char** data) {
-	CCONF_STATUS status = CCONF_STATUS_OK;
-	*data = 0;
-
-	FILE* f;
-
-	{
-		f = fopen(filepath, "rb");
-
-		if (f == NULL) {
-			_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
-		}
+// Counts the elements of the array that starts at the current position
+// (right after the open square bracket) without moving the lexer.
+// The result is only a hint, as the array is not validated.
+static inline size_t _cconf_lexer_count_elements(_CConfLexer* lexer) {
+	size_t count = 1;
+	char* p = &lexer->data[lexer->pos];
+	char* end = &lexer->data[lexer->len];
+
+	while (p < end) {
+		switch (*p) {
+		case ']':
+			return count;
+
+		case ',':
+			count++;
+			break;
 
-		if (fseek(f, 0, SEEK_END) != 0) {
-			_CCONF_RETURN_DEFER(CCONF_STATUS_FSEEK);
-		}
+		case CCONF_COMMENT:
+			p = (char*)memchr(p, '\n', end - p);
 
-		*len = ftell(f);
+			if (p == NULL) {
+				return count;
+			}
+			break;
 
-		if ((long long)*len == -1) {
-			_CCONF_RETURN_DEFER(CCONF_STATUS_FTELL);
-		}
+		case '\'':
+		case '"':
+			{
+				char d = *p++;
 
-		*data = (char*)malloc(*len);
-		if (*data == NULL) {
-			_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
-		}
+				while (p < end && *p != d) {
+					if (*p == '\\') {
+						p++;
+					}
 
-		if (fseek(f, 0, SEEK_SET) != 0) {
-			_CCONF_RETURN_DEFER(CCONF_STATUS_FSEEK);
+					p++;
+				}
+			}
+			break;
 		}
 
-		if (fread(*data, 1, *len, f) != *len) {
-			// NOTE: Technically this does not set errno
-			// even though that is the error that gets
-			// reported to the user
-			_CCONF_RETURN_DEFER(CCONF_STATUS_FREAD);
-		}
+		p++;
 	}
 
-	fclose(f);
-	return CCONF_STATUS_OK;
+	return count;
+}
 
-defer:
-	if (f != NULL) {
-		fclose(f);
-	}
+// Moves the lexer forward to `pos`, keeping the row and column updated
+static inline void _cconf_lexer_advance(_CConfLexer* lexer, size_t pos) {
+	char* p = &lexer->data[lexer->pos];
+	char* end = &lexer->data[pos];
+	char* nl;
 
-	if (*data != 0) {
-		free(*data);
+	while ((nl = (char*)memchr(p, '\n', end - p)) != NULL) {
+		lexer->row++;
+		lexer->col = 0;
+		p = nl + 1;
 	}
 
-	return status;
+	lexer->col += end - p;
+	lexer->pos = pos;
 }
 
-static inline bool _cconf_parser_expect_tokens(_CConfLexer* lexer, uint16_t tokens, _CConfToken* token) {
-	*token = _cconf_lexer_next_token(lexer);
+// Skips the value of a field, starting right after the equals sign, up to
+// and including the newline that terminates it. Quotes and brackets may
+// span multiple lines, but nothing is validated nor decoded.
+static inline void _cconf_lexer_skip_value(_CConfLexer* lexer) {
+	char* start = lexer->data;
+	char* p = &lexer->data[lexer->pos];
+	char* end = &lexer->data[lexer->len];
+	size_t depth = 0;
+
+	if (p >= end) {
+		return;
+	}
+
+	// Newlines and comments can appear before the value
+	while (p < end && (_cconf_isspace(*p) || *p == '\n' || *p == CCONF_COMMENT)) {
+		if (*p == CCONF_COMMENT) {
+			p = (char*)memchr(p, '\n', end - p);
+
+			if (p == NULL) {
+				p = end;
+				break;
+			}
+		}
+
+		p++;
+	}
+
+	while (p < end) {
+		switch (*p) {
+		case '\n':
+			if (depth == 0) {
+				p++;
+				goto end;
+			}
+			break;
+
+		case '[':
+			depth++;
+			break;
+
+		case ']':
+			if (depth > 0) {
+				depth--;
+			}
+			break;
+
+		case CCONF_COMMENT:
+			// Keep the newline, it may end the value
+			p = (char*)memchr(p, '\n', end - p);
+
+			if (p == NULL) {
+				p = end;
+			}
+			continue;
+
+		case '\'':
+		case '"':
+			{
+				char d = *p++;
+
+				while (p < end && *p != d) {
+					if (*p == '\\') {
+						p++;
+					}
+
+					p++;
+				}
+			}
+			break;
+		}
+
+		p++;
+	}
+
+end:
+	// The last character is never lexed, see _cconf_lexer_is_eof()
+	if ((size_t)(p - start) >= lexer->len) {
+		p = start + lexer->len - 1;
+	}
+
+	_cconf_lexer_advance(lexer, p - start);
+}
+
+// Reads a file from `offset` to its end
+static inline CCONF_STATUS _cconf_read_file_from(const char* filepath, size_t offset, size_t* len, char** data) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	*data = 0;
+
+	FILE* f;
+
+	{
+		f = fopen(filepath, "rb");
+
+		if (f == NULL) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
+		}
+
+		if (fseek(f, 0, SEEK_END) != 0) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FSEEK);
+		}
+
+		*len = ftell(f);
+
+		if ((long long)*len == -1) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FTELL);
+		}
+
+		if (offset > *len) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FSEEK);
+		}
+
+		*len -= offset;
+
+		*data = (char*)malloc(*len);
+		if (*data == NULL) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
+		}
+
+		if (fseek(f, (long)offset, SEEK_SET) != 0) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FSEEK);
+		}
+
+		if (fread(*data, 1, *len, f) != *len) {
+			// NOTE: Technically this does not set errno
+			// even though that is the error that gets
+			// reported to the user
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FREAD);
+		}
+	}
+
+	fclose(f);
+	return CCONF_STATUS_OK;
+
+defer:
+	if (f != NULL) {
+		fclose(f);
+	}
+
+	if (*data != 0) {
+		free(*data);
+	}
+
+	return status;
+}
+
+static inline CCONF_STATUS _cconf_read_entire_file(const char* filepath, size_t* len, char** data) {
+	return _cconf_read_file_from(filepath, 0, len, data);
+}
+
+static inline bool _cconf_parser_expect_tokens(_CConfLexer* lexer, uint16_t tokens, _CConfToken* token) {
+	*token = _cconf_lexer_next_token(lexer);
 	return (tokens & token->type) != 0;
 }
 
-// TODO: Make all parser errors return the execution to the user
-// so that they can decide to call this function if they want a
-// formatted error message. This should also not call exit() and
-// the user should be able to free up all resources in case of a failure.
-static inline void _cconf_parser_expect_error(uint16_t expected, _CConfToken* got) {
+static inline void _cconf_parser_format_error(uint16_t expected, _CConfToken* got, char* buf) {
 	assert(expected != 0 && "Incorrect expected tokens value");
 
-	char buf[1024] = { 0 };
-
+	buf[0] = 0;
 	_cconf_token_format_line(got, buf);
 	strcat(buf, ": ERROR: Expected token");
 
@@ -659,6 +1547,14 @@ static inline void _cconf_parser_expect_error(uint16_t expected, _CConfToken* go
 
 	strcat(buf, " but got ");
 	_cconf_token_format_name((_CCONF_LEXER_TOKEN)got->type, buf);
+}
+
+// TODO: Make cconf_load() return the execution to the user on parser
+// errors, like cconf_reader_next() does, so that the user is able to
+// free up all resources in case of a failure.
+static inline void _cconf_parser_expect_error(uint16_t expected, _CConfToken* got) {
+	char buf[CCONF_ERROR_SIZE];
+	_cconf_parser_format_error(expected, got, buf);
 
 	// TODO: Remove exit() calls from the library
 	fputs(buf, stderr);
@@ -707,612 +1603,5208 @@ static inline uint8_t _cconf_parser_get_type(_CCONF_LEXER_TOKEN type) {
 	}
 }
 
-static inline void _cconf_parser_get_primitive(_CConfToken token, CConfAs* out) {
+// Decodes the value of a token, returns false when it is malformed
+static inline bool _cconf_parser_get_primitive(_CConfToken token, CConfAs* out) {
 	switch (token.type) {
 	case _CCONF_LEXER_STRING:
 		out->str = _cconf_parser_copy_string(token);
 		break;
 
 	case _CCONF_LEXER_NUMBER:
-		out->num = strtoll(token.data, NULL, 10);
-		break;
+	case _CCONF_LEXER_DECIMAL: {
+		// The data is not NUL-terminated, a number at the end of
+		// the file would make strtoll/strtod read past it
+		char small[64];
+		char* buf = token.len < sizeof(small) ? small : (char*)malloc(token.len + 1);
 
-	case _CCONF_LEXER_DECIMAL:
-		out->dec = strtod(token.data, NULL);
+		if (buf == NULL) {
+			return false;
+		}
+
+		memcpy(buf, token.data, token.len);
+		buf[token.len] = 0;
+
+		if (token.type == _CCONF_LEXER_NUMBER) {
+			out->num = strtoll(buf, NULL, 10);
+		}
+		else {
+			out->dec = strtod(buf, NULL);
+		}
+
+		if (buf != small) {
+			free(buf);
+		}
 		break;
+	}
 
 	case _CCONF_LEXER_BOOLEAN:
-		if (strncmp(token.data, "true", 4) == 0) {
+		if (token.len == 4 && memcmp(token.data, "true", 4) == 0) {
 			out->boolean = true;
-
 		}
-		else if (strncmp(token.data, "false", 5) == 0) {
+		else if (token.len == 5 && memcmp(token.data, "false", 5) == 0) {
 			out->boolean = false;
-
 		}
 		else {
-			assert(0 && "Unreachable");
+			return false;
 		}
 		break;
 
 	default:
-		assert(0 && "Unreachable");
+		return false;
 	}
-}
 
-static inline bool _cconf_parse(
-	CConfFile* cconf,
-	_CConfLexer* lexer,
-	CCONF_HANDLER* handler,
-	void* user
-) {
-	_CConfToken name_token;
-	_CConfToken value_token;
-	bool present;
+	return true;
+}
 
-	while (true) {
-		present = _cconf_parser_expect_tokens(
-			lexer,
-			_CCONF_LEXER_LITERAL | _CCONF_LEXER_EOF | _CCONF_LEXER_NEWLINE,
-			&name_token
-		);
+// --------------------------------------------------
+// Bulk parsing of number and decimal arrays
 
-		if (!present) {
-			_cconf_parser_expect_error(_CCONF_LEXER_LITERAL | _CCONF_LEXER_EOF | _CCONF_LEXER_NEWLINE, &name_token);
-			return false;
-		}
+#if defined(_WIN32) || \
+	(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define _CCONF_LITTLE_ENDIAN
+#endif
 
-		if (name_token.type == _CCONF_LEXER_NEWLINE) {
-			continue;
-		}
-		else if (name_token.type == _CCONF_LEXER_EOF) {
-			break;
-		}
+typedef enum {
+	_CCONF_BULK_ELEMENT = 0,
+	_CCONF_BULK_END,
+	_CCONF_BULK_FALLBACK
+} _CCONF_BULK;
+
+static inline bool _cconf_bulk_is_eight_digits(const char* p) {
+#ifdef _CCONF_LITTLE_ENDIAN
+	uint64_t v;
+	memcpy(&v, p, 8);
+
+	return ((v & 0xF0F0F0F0F0F0F0F0ull) |
+		(((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+		0x3333333333333333ull;
+#else
+	(void)p;
+	return false;
+#endif
+}
 
-		while (true) {
-			present = _cconf_parser_expect_tokens(
-				lexer,
-				_CCONF_LEXER_EQUALS | _CCONF_LEXER_NEWLINE,
-				&value_token
-			);
+static inline uint32_t _cconf_bulk_parse_eight_digits(const char* p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
 
-			if (!present) {
-				_cconf_parser_expect_error(
-					_CCONF_LEXER_EQUALS | _CCONF_LEXER_NEWLINE,
-					&value_token
-				);
-				return false;
-			}
+	v = (v & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+	v = (v & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+	return (uint32_t)((v & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+}
 
-			if (value_token.type == _CCONF_LEXER_NEWLINE) {
-				continue;
-			}
+// Accumulates a run of digits into `m`, eight at a time when possible.
+// `digits` counts the accumulated digits, the ones that do not fit
+// into `m` are skipped and counted in `dropped`.
+static inline const char* _cconf_bulk_digits(
+	const char* p,
+	const char* end,
+	uint64_t* m,
+	size_t* digits,
+	size_t* dropped
+) {
+	while (end - p >= 8 && *digits + 8 <= 19 && _cconf_bulk_is_eight_digits(p)) {
+		*m = *m * 100000000 + _cconf_bulk_parse_eight_digits(p);
+		*digits += 8;
+		p += 8;
+	}
 
-			break;
+	while (p < end && isdigit((unsigned char)*p)) {
+		if (*digits < 19) {
+			*m = *m * 10 + (*p - '0');
+			(*digits)++;
+		}
+		else {
+			(*dropped)++;
 		}
 
-		while (true) {
-			present = _cconf_parser_expect_tokens(
-				lexer,
-				_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
-				_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
-				_CCONF_LEXER_OSQUARE | _CCONF_LEXER_NEWLINE,
-				&value_token
-			);
-
-			if (!present) {
-				_cconf_parser_expect_error(
-					_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
-					_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
-					_CCONF_LEXER_OSQUARE | _CCONF_LEXER_NEWLINE,
-					&value_token
-				);
-				return false;
-			}
+		p++;
+	}
 
-			if (value_token.type == _CCONF_LEXER_NEWLINE) {
-				continue;
-			}
+	return p;
+}
 
-			break;
+static inline bool _cconf_bulk_skip_space(const char** p, const char* end, size_t* row, size_t* col) {
+	while (*p < end) {
+		if (**p == '\n') {
+			(*row)++;
+			*col = 0;
+		}
+		else if (_cconf_isspace(**p)) {
+			(*col)++;
+		}
+		else {
+			return true;
 		}
 
-		CConfField* field = (CConfField*)malloc(sizeof(CConfField));
-		field->startl = name_token.row;
-		field->endl = value_token.last_row;
-		field->dirty = false;
-
-		field->fieldname = cconf_string_from_sized_string(
-			name_token.data, name_token.len
-		);
-
-		switch (value_token.type) {
-		case _CCONF_LEXER_STRING:
-		case _CCONF_LEXER_NUMBER:
-		case _CCONF_LEXER_DECIMAL:
-		case _CCONF_LEXER_BOOLEAN:
-			field->type = _cconf_parser_get_type((_CCONF_LEXER_TOKEN)value_token.type);
-			_cconf_parser_get_primitive(value_token, &field->as);
-			break;
+		(*p)++;
+	}
 
-		case _CCONF_LEXER_OSQUARE:
-			while (true) {
-				present = _cconf_parser_expect_tokens(
-					lexer,
-					_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
-					_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
-					_CCONF_LEXER_NEWLINE,
-					&value_token
-				);
+	return false;
+}
 
-				if (!present) {
-					_cconf_parser_expect_error(
-						_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
-						_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
-						_CCONF_LEXER_NEWLINE,
-						&value_token
-					);
-					return false;
-				}
+// Parses the next element of a number or decimal array straight
+// from the lexer data, without going through the token machinery.
+// The lexer is only moved when an element or the end of the array is
+// returned, anything unusual (comments, malformed or mismatched values)
+// is left to the regular parser by returning _CCONF_BULK_FALLBACK.
+static inline uint8_t _cconf_parser_bulk_next(
+	_CConfLexer* lexer,
+	_CCONF_LEXER_TOKEN exp_token,
+	CConfAs* out,
+	_CConfToken* token
+) {
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22
+	};
 
-				if (value_token.type == _CCONF_LEXER_NEWLINE) {
-					continue;
-				}
+	if (lexer->len == 0) {
+		return _CCONF_BULK_FALLBACK;
+	}
 
-				break;
-			}
+	// The last character of the data is never lexed, see _cconf_lexer_is_eof
+	const char* end = &lexer->data[lexer->len - 1];
+	const char* p = &lexer->data[lexer->pos];
+	size_t row = lexer->row;
+	size_t col = lexer->col;
 
-			field->type = _cconf_parser_get_type((_CCONF_LEXER_TOKEN)value_token.type) +
-				(CCONF_TYPE_STRING_ARR - CCONF_TYPE_STRING);
+	if (!_cconf_bulk_skip_space(&p, end, &row, &col)) {
+		return _CCONF_BULK_FALLBACK;
+	}
 
-			CConfAs_da_init(&field->arr, 2);
-			{
-				CConfAs null_as = { 0 };
-				CConfAs_da_append(&field->arr, null_as);
-			}
-			_cconf_parser_get_primitive(value_token, &(field->arr.items[field->arr.count - 1]));
+	if (*p == ']') {
+		_CConfToken ret = _CCONF_TOKEN(row, row, col, p - lexer->data, 1, CSQUARE);
+		*token = ret;
 
-			{
-				_CCONF_LEXER_TOKEN exp_token = (_CCONF_LEXER_TOKEN)value_token.type;
+		lexer->pos = p - lexer->data + 1;
+		lexer->row = row;
+		lexer->col = col + 1;
+		return _CCONF_BULK_END;
+	}
 
-				while (true) {
-					while (true) {
-						present = _cconf_parser_expect_tokens(
-							lexer,
-							_CCONF_LEXER_COMMA | _CCONF_LEXER_CSQUARE |
-							_CCONF_LEXER_NEWLINE,
-							&value_token
-						);
+	if (*p != ',') {
+		return _CCONF_BULK_FALLBACK;
+	}
 
-						if (!present) {
-							_cconf_parser_expect_error(
-								_CCONF_LEXER_COMMA | _CCONF_LEXER_CSQUARE |
-								_CCONF_LEXER_NEWLINE,
-								&value_token
-							);
-							return false;
-						}
+	p++;
+	col++;
 
-						if (value_token.type == _CCONF_LEXER_NEWLINE) {
-							continue;
-						}
+	if (!_cconf_bulk_skip_space(&p, end, &row, &col)) {
+		return _CCONF_BULK_FALLBACK;
+	}
 
-						break;
-					}
+	const char* start = p;
+	bool negative = false;
+	bool separator = false;
+	uint64_t m = 0;
+	size_t digits = 0;
+	size_t dropped = 0;
+	size_t fraction = 0;
+
+	if (*p == '-' || *p == '+') {
+		negative = *p == '-';
+		p++;
+	}
 
-					if (value_token.type == _CCONF_LEXER_CSQUARE) {
-						break;
-					}
+	p = _cconf_bulk_digits(p, end, &m, &digits, &dropped);
 
-					while (true) {
-						present = _cconf_parser_expect_tokens(
-							lexer,
-							exp_token | _CCONF_LEXER_NEWLINE,
-							&value_token
-						);
+	if (p < end && *p == '.') {
+		size_t before = digits;
 
-						if (!present) {
-							_cconf_parser_expect_error(
-								exp_token | _CCONF_LEXER_NEWLINE,
-								&value_token
-							);
-							return false;
-						}
+		separator = true;
+		p = _cconf_bulk_digits(p + 1, end, &m, &digits, &dropped);
+		fraction = digits - before;
+	}
 
-						if (value_token.type == _CCONF_LEXER_NEWLINE) {
-							continue;
-						}
+	if (
+		digits + dropped == 0 ||
+		p >= end ||
+		(*p != ',' && *p != ']' && *p != '\n' && *p != CCONF_COMMENT && !_cconf_isspace(*p)) ||
+		separator != (exp_token == _CCONF_LEXER_DECIMAL)
+	) {
+		return _CCONF_BULK_FALLBACK;
+	}
 
-						break;
-					}
+	if (exp_token == _CCONF_LEXER_NUMBER) {
+		if (dropped == 0 && m <= (uint64_t)INT64_MAX) {
+			out->num = negative ? -(int64_t)m : (int64_t)m;
+		}
+		else {
+			out->num = strtoll(start, NULL, 10);
+		}
+	}
+	else {
+		// Both values are exactly representable, so the division
+		// is correctly rounded (Clinger's fast path)
+		if (dropped == 0 && m <= (1ull << 53) && fraction <= 22) {
+			out->dec = (double)m / pow10[fraction];
 
-					{
-						CConfAs null_as = { 0 };
-						CConfAs_da_append(&field->arr, null_as);
-					}
-					_cconf_parser_get_primitive(value_token, &(field->arr.items[field->arr.count - 1]));
-				}
+			if (negative) {
+				out->dec = -out->dec;
 			}
-
-			field->endl = value_token.last_row;
-			break;
 		}
+		else {
+			out->dec = strtod(start, NULL);
+		}
+	}
+
+	{
+		_CConfToken ret = _CCONF_TOKEN(row, row, col, start - lexer->data, (size_t)(p - start), NUMBER);
+		ret.type = exp_token;
+		*token = ret;
+	}
+
+	lexer->pos = p - lexer->data;
+	lexer->row = row;
+	lexer->col = col + (p - start);
+	return _CCONF_BULK_ELEMENT;
+}
+
+// --------------------------------------------------
+// Schema related functions
+
+static inline bool _cconf_schema_equal(const void* key, size_t index, const void* user) {
+	const _CConfName* name = (const _CConfName*)key;
+	const CConfString* fieldname = ((const CConfSchema*)user)->entries[index].fieldname;
+
+	return CCONF_STRING_SIZE(fieldname) == name->len && memcmp(fieldname, name->data, name->len) == 0;
+}
+
+static inline const _CConfSchemaEntry* _cconf_schema_find(const CConfSchema* schema, const char* name, size_t len) {
+	_CConfName key = { name, len };
+	int64_t index = _cconf_hashtable_get(&schema->table, _cconf_hash(name, len), &key, _cconf_schema_equal, schema);
+
+	return index < 0 ? NULL : &schema->entries[index];
+}
+
+static inline uint8_t _cconf_schema_check_value(const CConfSchema* schema, const _CConfSchemaEntry* entry, CConfAs value) {
+	_Static_assert(CCONF_TYPE_AMOUNT == 8, "Incorrect type amount");
+
+	switch (entry->type) {
+	case CCONF_TYPE_NUMBER:
+	case CCONF_TYPE_NUMBER_ARR:
+		if ((entry->flags & CCONF_SCHEMA_RANGE) && (value.num < entry->lo.num || value.num > entry->hi.num)) {
+			return CCONF_SCHEMA_ERROR_RANGE;
+		}
+		break;
+
+	case CCONF_TYPE_DECIMAL:
+	case CCONF_TYPE_DECIMAL_ARR:
+		if ((entry->flags & CCONF_SCHEMA_RANGE) && !(value.dec >= entry->lo.dec && value.dec <= entry->hi.dec)) {
+			return CCONF_SCHEMA_ERROR_RANGE;
+		}
+		break;
+
+	case CCONF_TYPE_STRING:
+	case CCONF_TYPE_STRING_ARR:
+		if (
+			(entry->flags & CCONF_SCHEMA_LENGTH) && (
+				(int64_t)CCONF_STRING_SIZE(value.str) < entry->lo.num ||
+				(int64_t)CCONF_STRING_SIZE(value.str) > entry->hi.num
+			)
+		) {
+			return CCONF_SCHEMA_ERROR_LENGTH;
+		}
+
+		if (entry->flags & CCONF_SCHEMA_ENUM) {
+			for (size_t i = entry->enum_start; i < entry->enum_start + entry->enum_count; i++) {
+				if (
+					CCONF_STRING_SIZE(schema->enums[i]) == CCONF_STRING_SIZE(value.str) &&
+					memcmp(schema->enums[i], value.str, CCONF_STRING_SIZE(value.str)) == 0
+				) {
+					return CCONF_SCHEMA_ERROR_NONE;
+				}
+			}
+
+			return CCONF_SCHEMA_ERROR_ENUM;
+		}
+		break;
+	}
+
+	return CCONF_SCHEMA_ERROR_NONE;
+}
+
+// Checks a field that was not read by the parser, such as a journal record,
+// the same way the parser checks the values it reads. Sets `element` to
+// the element that broke the rule.
+static inline uint8_t _cconf_schema_check_field(
+	const CConfSchema* schema,
+	const _CConfSchemaEntry* entry,
+	const CConfField* field,
+	size_t* element
+) {
+	uint8_t error;
+
+	*element = 0;
+
+	if (field->type != entry->type) {
+		return CCONF_SCHEMA_ERROR_TYPE;
+	}
+
+	if (field->type < CCONF_TYPE_STRING_ARR) {
+		return _cconf_schema_check_value(schema, entry, field->as);
+	}
+
+	for (*element = 0; *element < field->arr.count; (*element)++) {
+		if ((entry->flags & CCONF_SCHEMA_COUNT) && *element + 1 > entry->max_count) {
+			return CCONF_SCHEMA_ERROR_COUNT;
+		}
+
+		if ((error = _cconf_schema_check_value(schema, entry, field->arr.items[*element])) != CCONF_SCHEMA_ERROR_NONE) {
+			return error;
+		}
+	}
+
+	if ((entry->flags & CCONF_SCHEMA_COUNT) && field->arr.count < entry->min_count) {
+		return CCONF_SCHEMA_ERROR_COUNT;
+	}
+
+	return CCONF_SCHEMA_ERROR_NONE;
+}
+
+static inline void _cconf_field_clear(CConfField* field) {
+	_Static_assert(CCONF_TYPE_AMOUNT == 8, "Incorrect type amount");
+
+	switch (field->type) {
+	case CCONF_TYPE_STRING:
+		cconf_string_free(field->as.str);
+		break;
+
+	case CCONF_TYPE_STRING_ARR:
+		for (size_t j = 0; j < field->arr.count; j++) {
+			cconf_string_free(field->arr.items[j].str);
+		}
+
+		// Fall through
+	case CCONF_TYPE_NUMBER_ARR:
+	case CCONF_TYPE_DECIMAL_ARR:
+	case CCONF_TYPE_BOOLEAN_ARR:
+		CConfAs_da_free(&field->arr);
+		break;
+	}
+
+	cconf_array_index_free(field);
+	cconf_string_free(field->fieldname);
+}
+
+// Marks a field as not being inside the file
+static inline void _cconf_field_unplace(CConfField* field) {
+	field->startl = -1;
+	field->endl = -1;
+	field->start = -1;
+	field->end = -1;
+	field->value.start = -1;
+	field->value.end = -1;
+	field->value.startl = -1;
+	field->value.endl = -1;
+}
+
+static inline void _cconf_field_free(CConfField* field) {
+	_cconf_field_clear(field);
+	free(field);
+}
+
+static inline CCONF_STATUS _cconf_parser_init(
+	_CConfParser* parser,
+	_CConfLexer* lexer,
+	uint32_t flags,
+	CCONF_ELEMENT_HANDLER* element_handler,
+	void* user,
+	const CConfSchema* schema,
+	CConfSchemaViolation* violation
+) {
+	memset(parser, 0, sizeof(_CConfParser));
+	parser->lexer.data = lexer->data;
+	parser->lexer.len = lexer->len;
+	parser->flags = flags;
+	parser->element_handler = element_handler;
+	parser->user = user;
+	parser->schema = schema;
+	parser->violation = violation;
+
+	violation->error = CCONF_SCHEMA_ERROR_NONE;
+
+	if (schema != NULL && schema->required != 0) {
+		parser->seen = (uint8_t*)calloc(schema->count, sizeof(uint8_t));
+
+		if (parser->seen == NULL) {
+			return CCONF_STATUS_MALLOC;
+		}
+	}
+
+	return CCONF_STATUS_OK;
+}
+
+static inline void _cconf_parser_free(_CConfParser* parser) {
+	free(parser->seen);
+	parser->seen = NULL;
+}
+
+static inline uint8_t _cconf_parser_syntax_error(_CConfParser* parser, uint16_t expected, _CConfToken* got) {
+	parser->expected = expected;
+	parser->got = *got;
+	return _CCONF_PARSE_SYNTAX;
+}
+
+static inline void _cconf_parser_schema_error(
+	_CConfParser* parser,
+	uint8_t error,
+	const _CConfSchemaEntry* entry,
+	size_t element,
+	_CConfToken* token
+) {
+	parser->violation->error = error;
+	parser->violation->rule = entry == NULL ? 0 : (size_t)(entry - parser->schema->entries);
+	parser->violation->element = element;
+	parser->violation->row = token->row;
+	parser->violation->col = token->col;
+}
+
+// Offset of the first character of a value token, quotes included
+static inline size_t _cconf_token_start(_CConfLexer* lexer, _CConfToken* token) {
+	size_t start = token->data - lexer->data;
+
+	// The data of strings starts after the opening quote
+	return token->type == _CCONF_LEXER_STRING ? start - 1 : start;
+}
+
+// Offset right after the last character of a value token, quotes included
+static inline size_t _cconf_token_end(_CConfLexer* lexer, _CConfToken* token) {
+	size_t end = (token->data - lexer->data) + token->len;
+
+	if (token->type == _CCONF_LEXER_STRING) {
+		return end + 1;
+	}
+
+	// Tokens that end right before the end of the file are one short
+	if (token->type != _CCONF_LEXER_CSQUARE) {
+		while (end < lexer->len && (isalnum(lexer->data[end]) || lexer->data[end] == '.')) {
+			end++;
+		}
+	}
+
+	return end;
+}
+
+// Parses the next field into `field`, which is only set when
+// _CCONF_PARSE_FIELD is returned. On errors, all the memory allocated
+// for the field is released, and the details are stored in the parser.
+static inline uint8_t _cconf_parse_field(_CConfParser* parser, CConfField* field) {
+	_CConfLexer* lexer = &parser->lexer;
+	const CConfSchema* schema = parser->schema;
+	const _CConfSchemaEntry* rule = NULL;
+	_CConfToken name_token;
+	_CConfToken value_token;
+	bool present;
+	uint8_t error;
+	size_t element;
+	size_t capacity;
+
+	if (parser->stopped) {
+		return _CCONF_PARSE_EOF;
+	}
+
+	while (true) {
+		while (true) {
+			present = _cconf_parser_expect_tokens(
+				lexer,
+				_CCONF_LEXER_LITERAL | _CCONF_LEXER_EOF | _CCONF_LEXER_NEWLINE,
+				&name_token
+			);
+
+			if (!present) {
+				return _cconf_parser_syntax_error(
+					parser,
+					_CCONF_LEXER_LITERAL | _CCONF_LEXER_EOF | _CCONF_LEXER_NEWLINE,
+					&name_token
+				);
+			}
+
+			if (name_token.type != _CCONF_LEXER_NEWLINE) {
+				break;
+			}
+		}
+
+		if (name_token.type == _CCONF_LEXER_EOF) {
+			if (parser->seen != NULL && parser->selector == NULL) {
+				for (size_t i = 0; i < schema->count; i++) {
+					if ((schema->entries[i].flags & CCONF_SCHEMA_REQUIRED) && !parser->seen[i]) {
+						_cconf_parser_schema_error(parser, CCONF_SCHEMA_ERROR_MISSING, &schema->entries[i], 0, &name_token);
+						return _CCONF_PARSE_SCHEMA;
+					}
+				}
+			}
+
+			return _CCONF_PARSE_EOF;
+		}
+
+		if (parser->selector == NULL) {
+			break;
+		}
+
+		uint8_t selected = parser->selector(name_token.data, name_token.len, parser->selector_user);
+
+		if (selected == CCONF_SELECT_LOAD) {
+			break;
+		}
+
+		if (selected == CCONF_SELECT_LAST) {
+			parser->stopped = true;
+			break;
+		}
+
+		if (selected == CCONF_SELECT_STOP) {
+			parser->stopped = true;
+			return _CCONF_PARSE_EOF;
+		}
+
+		while (true) {
+			present = _cconf_parser_expect_tokens(
+				lexer,
+				_CCONF_LEXER_EQUALS | _CCONF_LEXER_NEWLINE,
+				&value_token
+			);
+
+			if (!present) {
+				return _cconf_parser_syntax_error(
+					parser,
+					_CCONF_LEXER_EQUALS | _CCONF_LEXER_NEWLINE,
+					&value_token
+				);
+			}
+
+			if (value_token.type != _CCONF_LEXER_NEWLINE) {
+				break;
+			}
+		}
+
+		_cconf_lexer_skip_value(lexer);
+	}
+
+	if (schema != NULL) {
+		rule = _cconf_schema_find(schema, name_token.data, name_token.len);
+
+		if (rule == NULL && schema->strict) {
+			_cconf_parser_schema_error(parser, CCONF_SCHEMA_ERROR_UNKNOWN, NULL, 0, &name_token);
+			return _CCONF_PARSE_SCHEMA;
+		}
+
+		if (rule != NULL && parser->seen != NULL) {
+			parser->seen[rule - schema->entries] = 1;
+		}
+	}
+
+	while (true) {
+		present = _cconf_parser_expect_tokens(
+			lexer,
+			_CCONF_LEXER_EQUALS | _CCONF_LEXER_NEWLINE,
+			&value_token
+		);
+
+		if (!present) {
+			return _cconf_parser_syntax_error(
+				parser,
+				_CCONF_LEXER_EQUALS | _CCONF_LEXER_NEWLINE,
+				&value_token
+			);
+		}
+
+		if (value_token.type == _CCONF_LEXER_NEWLINE) {
+			continue;
+		}
+
+		break;
+	}
+
+	while (true) {
+		present = _cconf_parser_expect_tokens(
+			lexer,
+			_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+			_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
+			_CCONF_LEXER_OSQUARE | _CCONF_LEXER_NEWLINE,
+			&value_token
+		);
+
+		if (!present) {
+			return _cconf_parser_syntax_error(
+				parser,
+				_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+				_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
+				_CCONF_LEXER_OSQUARE | _CCONF_LEXER_NEWLINE,
+				&value_token
+			);
+		}
+
+		if (value_token.type == _CCONF_LEXER_NEWLINE) {
+			continue;
+		}
+
+		break;
+	}
+
+	if (
+		rule != NULL &&
+		value_token.type != _CCONF_LEXER_OSQUARE &&
+		rule->type != _cconf_parser_get_type((_CCONF_LEXER_TOKEN)value_token.type)
+	) {
+		_cconf_parser_schema_error(parser, CCONF_SCHEMA_ERROR_TYPE, rule, 0, &value_token);
+		return _CCONF_PARSE_SCHEMA;
+	}
+
+	field->index = NULL;
+	field->startl = name_token.row;
+	field->endl = value_token.last_row;
+	field->start = (name_token.data - lexer->data) - name_token.col;
+	field->value.startl = value_token.row - field->startl;
+	field->value.start = _cconf_token_start(lexer, &value_token) - field->start;
+
+	field->pos = 0;
+	field->dirty = false;
+	field->journaled = false;
+	field->removed = false;
+	field->anchor = NULL;
+	field->generation = 0;
+	field->readers = 0;
+
+	field->fieldname = cconf_string_from_sized_string(
+		name_token.data, name_token.len
+	);
+
+	switch (value_token.type) {
+	case _CCONF_LEXER_STRING:
+	case _CCONF_LEXER_NUMBER:
+	case _CCONF_LEXER_DECIMAL:
+	case _CCONF_LEXER_BOOLEAN:
+		field->type = _cconf_parser_get_type((_CCONF_LEXER_TOKEN)value_token.type);
+
+		if (!_cconf_parser_get_primitive(value_token, &field->as)) {
+			cconf_string_free(field->fieldname);
+			return _cconf_parser_syntax_error(
+				parser,
+				_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+				_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
+				_CCONF_LEXER_OSQUARE | _CCONF_LEXER_NEWLINE,
+				&value_token
+			);
+		}
+
+		if (rule != NULL && (error = _cconf_schema_check_value(schema, rule, field->as)) != CCONF_SCHEMA_ERROR_NONE) {
+			_cconf_parser_schema_error(parser, error, rule, 0, &value_token);
+			_cconf_field_clear(field);
+			return _CCONF_PARSE_SCHEMA;
+		}
+		break;
+
+	case _CCONF_LEXER_OSQUARE:
+		if (parser->flags & CCONF_FLAG_PRECOUNT_ARRAYS) {
+			capacity = _cconf_lexer_count_elements(lexer);
+		}
+		else {
+			capacity = 2;
+		}
+
+		while (true) {
+			present = _cconf_parser_expect_tokens(
+				lexer,
+				_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+				_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
+				_CCONF_LEXER_NEWLINE,
+				&value_token
+			);
+
+			if (!present) {
+				cconf_string_free(field->fieldname);
+				return _cconf_parser_syntax_error(
+					parser,
+					_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+					_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
+					_CCONF_LEXER_NEWLINE,
+					&value_token
+				);
+			}
+
+			if (value_token.type == _CCONF_LEXER_NEWLINE) {
+				continue;
+			}
+
+			break;
+		}
+
+		field->type = _cconf_parser_get_type((_CCONF_LEXER_TOKEN)value_token.type) +
+			(CCONF_TYPE_STRING_ARR - CCONF_TYPE_STRING);
+
+		if (rule != NULL && rule->type != field->type) {
+			_cconf_parser_schema_error(parser, CCONF_SCHEMA_ERROR_TYPE, rule, 0, &value_token);
+			cconf_string_free(field->fieldname);
+			return _CCONF_PARSE_SCHEMA;
+		}
+
+		field->arr.items = NULL;
+		field->arr.count = 0;
+		field->arr.capacity = 0;
+		element = 0;
+
+		{
+			_CCONF_LEXER_TOKEN exp_token = (_CCONF_LEXER_TOKEN)value_token.type;
+			bool bulk = exp_token == _CCONF_LEXER_NUMBER || exp_token == _CCONF_LEXER_DECIMAL;
+			bool decoded = false;
+			CConfAs value;
+
+			while (true) {
+				if (!decoded) {
+					value.num = 0;
+
+					if (!_cconf_parser_get_primitive(value_token, &value)) {
+						_cconf_field_clear(field);
+						return _cconf_parser_syntax_error(parser, exp_token, &value_token);
+					}
+				}
+
+				if (rule != NULL) {
+					if ((rule->flags & CCONF_SCHEMA_COUNT) && element + 1 > rule->max_count) {
+						error = CCONF_SCHEMA_ERROR_COUNT;
+					}
+					else {
+						error = _cconf_schema_check_value(schema, rule, value);
+					}
+
+					if (error != CCONF_SCHEMA_ERROR_NONE) {
+						_cconf_parser_schema_error(parser, error, rule, element, &value_token);
+
+						if (field->type == CCONF_TYPE_STRING_ARR) {
+							cconf_string_free(value.str);
+						}
+
+						_cconf_field_clear(field);
+						return _CCONF_PARSE_SCHEMA;
+					}
+				}
+
+				if (
+					parser->element_handler == NULL ||
+					parser->element_handler(field, element, &value, parser->user)
+				) {
+					if (field->arr.items == NULL) {
+						CConfAs_da_init(&field->arr, capacity);
+					}
+
+					CConfAs_da_append(&field->arr, value);
+				}
+
+				element++;
+
+				if (bulk) {
+					uint8_t res = _cconf_parser_bulk_next(lexer, exp_token, &value, &value_token);
+
+					if (res == _CCONF_BULK_ELEMENT) {
+						decoded = true;
+						continue;
+					}
+					else if (res == _CCONF_BULK_END) {
+						break;
+					}
+				}
+
+				decoded = false;
+
+				while (true) {
+					present = _cconf_parser_expect_tokens(
+						lexer,
+						_CCONF_LEXER_COMMA | _CCONF_LEXER_CSQUARE |
+						_CCONF_LEXER_NEWLINE,
+						&value_token
+					);
+
+					if (!present) {
+						_cconf_field_clear(field);
+						return _cconf_parser_syntax_error(
+							parser,
+							_CCONF_LEXER_COMMA | _CCONF_LEXER_CSQUARE |
+							_CCONF_LEXER_NEWLINE,
+							&value_token
+						);
+					}
+
+					if (value_token.type == _CCONF_LEXER_NEWLINE) {
+						continue;
+					}
+
+					break;
+				}
+
+				if (value_token.type == _CCONF_LEXER_CSQUARE) {
+					break;
+				}
+
+				while (true) {
+					present = _cconf_parser_expect_tokens(
+						lexer,
+						exp_token | _CCONF_LEXER_NEWLINE,
+						&value_token
+					);
+
+					if (!present) {
+						_cconf_field_clear(field);
+						return _cconf_parser_syntax_error(
+							parser,
+							exp_token | _CCONF_LEXER_NEWLINE,
+							&value_token
+						);
+					}
+
+					if (value_token.type == _CCONF_LEXER_NEWLINE) {
+						continue;
+					}
+
+					break;
+				}
+			}
+		}
+
+		if (rule != NULL && (rule->flags & CCONF_SCHEMA_COUNT) && element < rule->min_count) {
+			_cconf_parser_schema_error(parser, CCONF_SCHEMA_ERROR_COUNT, rule, element, &value_token);
+			_cconf_field_clear(field);
+			return _CCONF_PARSE_SCHEMA;
+		}
+
+		if (
+			(parser->flags & CCONF_FLAG_INDEX_ARRAYS) &&
+			(field->type == CCONF_TYPE_STRING_ARR || field->type == CCONF_TYPE_NUMBER_ARR)
+		) {
+			cconf_array_index(field);
+		}
+
+		field->endl = value_token.last_row;
+		break;
+	}
+
+	// The last token of the value, a primitive or the closing square bracket
+	field->value.end = _cconf_token_end(lexer, &value_token) - field->start;
+	field->value.endl = field->endl - field->startl;
+
+	present = _cconf_parser_expect_tokens(
+		lexer,
+		_CCONF_LEXER_NEWLINE | _CCONF_LEXER_EOF,
+		&name_token
+	);
+
+	if (!present) {
+		_cconf_field_clear(field);
+		return _cconf_parser_syntax_error(parser, _CCONF_LEXER_NEWLINE | _CCONF_LEXER_EOF, &name_token);
+	}
+
+	// Trailing comments are part of the field
+	if (name_token.type == _CCONF_LEXER_EOF) {
+		field->end = lexer->len;
+	}
+	else {
+		field->end = lexer->pos;
+	}
+
+	return _CCONF_PARSE_FIELD;
+}
+
+// --------------------------------------------------
+// Journal related functions
+
+// Records read from the journal of a file
+typedef struct _CConfJournal {
+	pCConfField_da records;
+
+	_CConfHashTable table; // Latest record of every field
+
+	size_t size;
+	bool torn;
+} _CConfJournal;
+
+static inline char* _cconf_journal_path(const char* filepath) {
+	size_t len = strlen(filepath);
+	char* path = (char*)malloc(len + sizeof(".journal"));
+
+	if (path != NULL) {
+		memcpy(path, filepath, len);
+		memcpy(&path[len], ".journal", sizeof(".journal"));
+	}
+
+	return path;
+}
+
+static inline void _cconf_journal_free(_CConfJournal* journal) {
+	for (size_t i = 0; i < journal->records.count; i++) {
+		if (journal->records.items[i] != NULL) {
+			_cconf_field_free(journal->records.items[i]);
+		}
+	}
+
+	free(journal->records.items);
+	_cconf_hashtable_free(&journal->table);
+	memset(journal, 0, sizeof(_CConfJournal));
+}
+
+static inline bool _cconf_journal_equal(const void* key, size_t index, const void* user) {
+	const _CConfName* name = (const _CConfName*)key;
+	const CConfField* record = ((const _CConfJournal*)user)->records.items[index];
+
+	return CCONF_STRING_SIZE(record->fieldname) == name->len && memcmp(record->fieldname, name->data, name->len) == 0;
+}
+
+// Returns the slot of a field name, either empty or holding its record
+static inline size_t _cconf_journal_slot(_CConfJournal* journal, const CConfString* fieldname) {
+	_CConfName key = { fieldname, CCONF_STRING_SIZE(fieldname) };
+	return _cconf_hashtable_find(&journal->table, _cconf_hash(key.data, key.len), &key, _cconf_journal_equal, journal);
+}
+
+// Reads all the records of the journal of a file, where the later
+// records of a field replace the earlier ones. A missing journal is
+// empty, and a journal that ends with an incomplete record (after a
+// crash while appending to it) is read up to that record
+static inline CCONF_STATUS _cconf_journal_load(_CConfJournal* journal, const char* filepath) {
+	CCONF_STATUS status;
+	CConfReader reader;
+	char* path = _cconf_journal_path(filepath);
+
+	memset(journal, 0, sizeof(_CConfJournal));
+
+	if (path == NULL) {
+		return CCONF_STATUS_MALLOC;
+	}
+
+	status = cconf_reader_open(&reader, path);
+	free(path);
+
+	if (status == CCONF_STATUS_FOPEN) {
+		return CCONF_STATUS_OK;
+	}
+
+	if (status != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	pCConfField_da_init(&journal->records, 8);
+	journal->size = reader.parser.lexer.len;
+
+	while (true) {
+		CConfField* record = (CConfField*)malloc(sizeof(CConfField));
+
+		if (record == NULL) {
+			status = CCONF_STATUS_MALLOC;
+			break;
+		}
+
+		status = cconf_reader_next(&reader, record);
+
+		if (status != CCONF_STATUS_OK) {
+			free(record);
+			journal->torn = status != CCONF_STATUS_EOF;
+			status = status == CCONF_STATUS_MALLOC ? status : CCONF_STATUS_OK;
+			break;
+		}
+
+		pCConfField_da_append(&journal->records, record);
+	}
+
+	cconf_reader_close(&reader);
+
+	if (status != CCONF_STATUS_OK) {
+		_cconf_journal_free(journal);
+		return status;
+	}
+
+	if (!_cconf_hashtable_reset(&journal->table, journal->records.count)) {
+		_cconf_journal_free(journal);
+		return CCONF_STATUS_MALLOC;
+	}
+
+	for (size_t i = 0; i < journal->records.count; i++) {
+		uint32_t* slot = &journal->table.slots[_cconf_journal_slot(journal, journal->records.items[i]->fieldname)];
+
+		if (*slot != 0) {
+			_cconf_field_free(journal->records.items[*slot - 1]);
+			journal->records.items[*slot - 1] = NULL;
+		}
+
+		*slot = (uint32_t)(i + 1);
+	}
+
+	return CCONF_STATUS_OK;
+}
+
+// Whether a record satisfies the schema, which is not the case of the
+// records written before the schema changed. The position of violations
+// is the one of the record inside the journal.
+static inline bool _cconf_journal_check(
+	const CConfSchema* schema,
+	CConfField* record,
+	CConfSchemaViolation* violation
+) {
+	const _CConfSchemaEntry* entry;
+	size_t element = 0;
+	uint8_t error = CCONF_SCHEMA_ERROR_NONE;
+
+	if (schema == NULL) {
+		return true;
+	}
+
+	entry = _cconf_schema_find(schema, record->fieldname, CCONF_STRING_SIZE(record->fieldname));
+
+	if (entry == NULL && schema->strict) {
+		error = CCONF_SCHEMA_ERROR_UNKNOWN;
+	}
+	else if (entry != NULL) {
+		error = _cconf_schema_check_field(schema, entry, record, &element);
+	}
+
+	if (error == CCONF_SCHEMA_ERROR_NONE) {
+		return true;
+	}
+
+	violation->error = error;
+	violation->rule = entry == NULL ? 0 : (size_t)(entry - schema->entries);
+	violation->element = element;
+	violation->row = record->startl;
+	violation->col = 0;
+	return false;
+}
+
+// Replaces the value of a field with the one of its record, if any. The
+// record takes the old value, and is marked as replayed with `journaled`
+static inline uint8_t _cconf_journal_replay(_CConfParser* parser, CConfField* field) {
+	_CConfJournal* journal = parser->journal;
+	uint32_t index;
+	CConfField* record;
+	CConfField value;
+
+	if (journal->records.count == 0) {
+		return _CCONF_PARSE_FIELD;
+	}
+
+	index = journal->table.slots[_cconf_journal_slot(journal, field->fieldname)];
+
+	if (index == 0) {
+		return _CCONF_PARSE_FIELD;
+	}
+
+	record = journal->records.items[index - 1];
+
+	if (record->journaled) {
+		return _CCONF_PARSE_FIELD;
+	}
+
+	if (!_cconf_journal_check(parser->schema, record, parser->violation)) {
+		return _CCONF_PARSE_SCHEMA;
+	}
+
+	value = *record;
+
+	record->type = field->type;
+	record->arr = field->arr;
+	record->index = field->index;
+	record->journaled = true;
+
+	field->type = value.type;
+	field->arr = value.arr;
+	field->index = value.index;
+	field->journaled = true;
+
+	if (
+		(parser->flags & CCONF_FLAG_INDEX_ARRAYS) &&
+		(field->type == CCONF_TYPE_STRING_ARR || field->type == CCONF_TYPE_NUMBER_ARR)
+	) {
+		cconf_array_index(field);
+	}
+
+	return _CCONF_PARSE_FIELD;
+}
+
+static inline uint8_t _cconf_parse(CConfFile* cconf, _CConfParser* parser, CCONF_HANDLER* handler) {
+	uint8_t res;
+
+	while (true) {
+		CConfField* field = (CConfField*)malloc(sizeof(CConfField));
+		res = _cconf_parse_field(parser, field);
+
+		if (res != _CCONF_PARSE_FIELD) {
+			free(field);
+			return res;
+		}
+
+		field->pos = cconf->values.count;
+		pCConfField_da_append(&cconf->values, field);
+
+		if (parser->journal != NULL && (res = _cconf_journal_replay(parser, field)) != _CCONF_PARSE_FIELD) {
+			return res;
+		}
+
+		handler(field, parser->user);
+	}
+}
+
+// --------------------------------------------------
+// Selection related functions
+
+typedef struct {
+	const char* const* keys;
+	size_t count;
+
+	_CConfHashTable table; // Key indices
+
+	uint8_t* found;
+	size_t remaining;
+} _CConfKeySet;
+
+static inline bool _cconf_key_set_equal(const void* key, size_t index, const void* user) {
+	const _CConfName* name = (const _CConfName*)key;
+	const char* other = ((const _CConfKeySet*)user)->keys[index];
+
+	return strncmp(other, name->data, name->len) == 0 && other[name->len] == 0;
+}
+
+static inline CCONF_STATUS _cconf_key_set_init(_CConfKeySet* set, const char* const* keys, size_t count) {
+	memset(set, 0, sizeof(_CConfKeySet));
+	set->keys = keys;
+	set->count = count;
+	set->found = (uint8_t*)calloc(count + 1, sizeof(uint8_t));
+
+	if (!_cconf_hashtable_reset(&set->table, count) || set->found == NULL) {
+		_cconf_hashtable_free(&set->table);
+		free(set->found);
+		return CCONF_STATUS_MALLOC;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		_CConfName key = { keys[i], strlen(keys[i]) };
+		size_t slot = _cconf_hashtable_find(&set->table, _cconf_hash(key.data, key.len), &key, _cconf_key_set_equal, set);
+
+		// Duplicated keys are only counted once
+		if (set->table.slots[slot] == 0) {
+			set->table.slots[slot] = (uint32_t)(i + 1);
+			set->remaining++;
+		}
+	}
+
+	return CCONF_STATUS_OK;
+}
+
+static inline void _cconf_key_set_free(_CConfKeySet* set) {
+	_cconf_hashtable_free(&set->table);
+	free(set->found);
+}
+
+static inline uint8_t _cconf_key_set_select(const char* name, size_t len, void* user) {
+	_CConfKeySet* set = (_CConfKeySet*)user;
+	_CConfName key = { name, len };
+	int64_t index;
+
+	if (set->remaining == 0) {
+		return CCONF_SELECT_STOP;
+	}
+
+	index = _cconf_hashtable_get(&set->table, _cconf_hash(name, len), &key, _cconf_key_set_equal, set);
+
+	if (index < 0) {
+		return CCONF_SELECT_SKIP;
+	}
+
+	if (!set->found[index]) {
+		set->found[index] = 1;
+		set->remaining--;
+	}
+
+	return set->remaining == 0 ? CCONF_SELECT_LAST : CCONF_SELECT_LOAD;
+}
+
+// --------------------------------------------------
+// Validation related functions
+
+// Same as _cconf_parser_expect_tokens, but newlines are skipped
+static inline bool _cconf_validate_expect(_CConfLexer* lexer, uint16_t tokens, _CConfToken* token) {
+	while (_cconf_parser_expect_tokens(lexer, tokens | _CCONF_LEXER_NEWLINE, token)) {
+		if (token->type != _CCONF_LEXER_NEWLINE) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Walks the grammar of a single field, without decoding any value.
+// It must accept exactly what _cconf_parse_field accepts.
+static inline uint8_t _cconf_validate_field(_CConfLexer* lexer, uint16_t* expected, _CConfToken* got) {
+	_CConfToken token;
+	uint16_t exp_token;
+
+	*expected = _CCONF_LEXER_LITERAL | _CCONF_LEXER_EOF;
+	if (!_cconf_validate_expect(lexer, *expected, &token)) goto error;
+
+	if (token.type == _CCONF_LEXER_EOF) {
+		return _CCONF_PARSE_EOF;
+	}
+
+	*expected = _CCONF_LEXER_EQUALS;
+	if (!_cconf_validate_expect(lexer, *expected, &token)) goto error;
+
+	*expected = _CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+		_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN |
+		_CCONF_LEXER_OSQUARE;
+	if (!_cconf_validate_expect(lexer, *expected, &token)) goto error;
+
+	if (token.type == _CCONF_LEXER_OSQUARE) {
+		*expected = _CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+			_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN;
+		if (!_cconf_validate_expect(lexer, *expected, &token)) goto error;
+
+		exp_token = token.type;
+
+		while (true) {
+			*expected = _CCONF_LEXER_COMMA | _CCONF_LEXER_CSQUARE;
+			if (!_cconf_validate_expect(lexer, *expected, &token)) goto error;
+
+			if (token.type == _CCONF_LEXER_CSQUARE) {
+				break;
+			}
+
+			*expected = exp_token;
+			if (!_cconf_validate_expect(lexer, *expected, &token)) goto error;
+		}
+	}
+
+	// Newlines are not skipped here
+	*expected = _CCONF_LEXER_NEWLINE | _CCONF_LEXER_EOF;
+	if (!_cconf_parser_expect_tokens(lexer, *expected, &token)) goto error;
+
+	return _CCONF_PARSE_FIELD;
+
+error:
+	// Match the expected tokens reported by _cconf_parse_field
+	*expected |= _CCONF_LEXER_NEWLINE;
+	*got = token;
+	return _CCONF_PARSE_SYNTAX;
+}
+
+static inline CCONF_STATUS _cconf_validate(_CConfLexer* lexer, CConfDiagnostics* diagnostics) {
+	uint16_t expected;
+	_CConfToken got;
+
+	diagnostics->count = 0;
+	diagnostics->total = 0;
+
+	while (true) {
+		uint8_t res = _cconf_validate_field(lexer, &expected, &got);
+
+		if (res == _CCONF_PARSE_EOF) {
+			break;
+		}
+
+		if (res == _CCONF_PARSE_FIELD) {
+			continue;
+		}
+
+		if (diagnostics->count < diagnostics->capacity) {
+			CConfDiagnostic* diagnostic = &diagnostics->items[diagnostics->count++];
+			diagnostic->row = got.row;
+			diagnostic->col = got.col;
+			diagnostic->expected = expected;
+			diagnostic->got = got.type;
+		}
+
+		diagnostics->total++;
+
+		if (got.type == _CCONF_LEXER_EOF) {
+			break;
+		}
+
+		// Resume from the next line
+		{
+			char c = 0;
+			while (c != '\n' && _cconf_lexer_next(lexer, &c)) {}
+		}
+	}
+
+	return diagnostics->total == 0 ? CCONF_STATUS_OK : CCONF_STATUS_PARSE;
+}
+
+// --------------------------------------------------
+// Array index related functions
+
+static inline uint32_t _cconf_hash_number(int64_t num) {
+	// splitmix64 finalizer
+	uint64_t x = (uint64_t)num;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return (uint32_t)(x ^ (x >> 31));
+}
+
+static inline uint32_t _cconf_array_hash(uint8_t type, CConfAs value) {
+	if (type == CCONF_TYPE_STRING_ARR) {
+		return _cconf_hash(value.str, CCONF_STRING_SIZE(value.str));
+	}
+
+	return _cconf_hash_number(value.num);
+}
+
+static inline bool _cconf_array_equal_string(const void* key, size_t index, const void* user) {
+	const _CConfName* name = (const _CConfName*)key;
+	const CConfString* item = ((const CConfField*)user)->arr.items[index].str;
+
+	return CCONF_STRING_SIZE(item) == name->len && memcmp(item, name->data, name->len) == 0;
+}
+
+static inline bool _cconf_array_equal_number(const void* key, size_t index, const void* user) {
+	return ((const CConfField*)user)->arr.items[index].num == *(const int64_t*)key;
+}
+
+static inline bool _cconf_array_index_stale(CConfField* field) {
+	return field->index == NULL ||
+		field->index->items != field->arr.items ||
+		field->index->count != field->arr.count;
+}
+
+
+static inline void _cconf_output_write(_CConfOutput* out, const char* s, size_t len) {
+	if (out->capacity == 0) {
+		_CConfOutput_init(out, len > 256 ? len : 256);
+	}
+
+	if (out->capacity - out->count < len) {
+		while (out->capacity - out->count < len) {
+			out->capacity *= 2;
+		}
+
+		out->items = (char*)realloc(out->items, out->capacity);
+	}
+
+	memcpy(&out->items[out->count], s, len);
+	out->count += len;
+}
+
+// Parts of the new contents of a file, either unchanged spans of the
+// old file or text inside the output buffer
+typedef struct {
+	size_t offset;
+	size_t len;
+	bool unchanged;
+} _CConfSegment;
+
+_CCONF_CREATE_DA(_CConfSegment, _CConfSegment_da)
+
+static inline void _cconf_segment_add(_CConfSegment_da* segments, bool unchanged, size_t offset, size_t len) {
+	if (len == 0) {
+		return;
+	}
+
+	if (segments->count > 0) {
+		_CConfSegment* last = &segments->items[segments->count - 1];
+
+		if (last->unchanged == unchanged && last->offset + last->len == offset) {
+			last->len += len;
+			return;
+		}
+	}
+
+	_CConfSegment segment = { offset, len, unchanged };
+	_CConfSegment_da_append(segments, segment);
+}
+
+// `data` holds the old contents of the file starting from `base`
+static inline const char* _cconf_segment_data(_CConfSegment* segment, const char* data, size_t base, const _CConfOutput* out) {
+	return segment->unchanged ? &data[segment->offset - base] : &out->items[segment->offset];
+}
+
+// Returns how many bytes at the start of the file are left unchanged
+static inline size_t _cconf_segments_prefix(_CConfSegment_da* segments) {
+	if (segments->count > 0 && segments->items[0].unchanged && segments->items[0].offset == 0) {
+		return segments->items[0].len;
+	}
+
+	return 0;
+}
+
+// Joins all the segments into a single buffer
+static inline char* _cconf_segments_join(_CConfSegment_da* segments, const char* data, const _CConfOutput* out, size_t len) {
+	char* res = (char*)malloc(len + 1);
+	size_t pos = 0;
+
+	if (res == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < segments->count; i++) {
+		_CConfSegment* segment = &segments->items[i];
+
+		memcpy(&res[pos], _cconf_segment_data(segment, data, 0, out), segment->len);
+		pos += segment->len;
+	}
+
+	return res;
+}
+
+#ifdef _CCONF_POSIX
+static inline bool _cconf_write_all(int fd, const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		data += written;
+		len -= written;
+	}
+
+	return true;
+}
+#endif
+
+// Replaces the contents of a file with a single write
+static inline CCONF_STATUS _cconf_write_file(const char* filepath, const char* data, size_t len) {
+#ifdef _CCONF_POSIX
+	int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if (fd < 0) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	if (!_cconf_write_all(fd, data, len)) {
+		close(fd);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (close(fd) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+#else
+	FILE* f = fopen(filepath, "wb");
+
+	if (f == NULL) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	if (fwrite(data, 1, len, f) != len) {
+		fclose(f);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (fclose(f) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+#endif
+}
+
+#ifdef _CCONF_POSIX
+// Writes the segments that follow the first `from` bytes of the new
+// contents at the current position of `fd`, without joining them
+static inline bool _cconf_writev_segments(
+	int fd,
+	_CConfSegment_da* segments,
+	const char* data,
+	size_t base,
+	const _CConfOutput* out,
+	size_t from
+) {
+#ifdef IOV_MAX
+	enum { batch_size = IOV_MAX < 64 ? IOV_MAX : 64 };
+#else
+	enum { batch_size = 16 };
+#endif
+
+	struct iovec iov[batch_size];
+	size_t pos = 0;
+	size_t i = 0;
+
+	while (i < segments->count) {
+		int count = 0;
+		size_t total = 0;
+
+		for (; i < segments->count && count < batch_size; i++) {
+			_CConfSegment* segment = &segments->items[i];
+			size_t skip = 0;
+
+			pos += segment->len;
+
+			if (pos <= from) {
+				continue;
+			}
+
+			if (pos - segment->len < from) {
+				skip = from - (pos - segment->len);
+			}
+
+			iov[count].iov_base = segment->unchanged ?
+				(void*)&data[segment->offset + skip - base] :
+				(void*)&out->items[segment->offset + skip];
+			iov[count].iov_len = segment->len - skip;
+			total += segment->len - skip;
+			count++;
+		}
+
+		if (count == 0) {
+			break;
+		}
+
+		ssize_t written = writev(fd, iov, count);
+
+		if (written < 0 && errno != EINTR) {
+			return false;
+		}
+
+		if (written < 0) {
+			written = 0;
+		}
+
+		// Finish short writes one segment at a time
+		if ((size_t)written != total) {
+			for (int k = 0; k < count; k++) {
+				size_t len = iov[k].iov_len;
+
+				if ((size_t)written >= len) {
+					written -= len;
+					continue;
+				}
+
+				if (!_cconf_write_all(fd, (const char*)iov[k].iov_base + written, len - written)) {
+					return false;
+				}
+
+				written = 0;
+			}
+		}
+	}
+
+	return true;
+}
+#endif
+
+// Replaces the contents of a file with the segments
+static inline CCONF_STATUS _cconf_write_segments(
+	const char* filepath,
+	_CConfSegment_da* segments,
+	const char* data,
+	const _CConfOutput* out
+) {
+#ifdef _CCONF_POSIX
+	int fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+	if (fd < 0) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	if (!_cconf_writev_segments(fd, segments, data, 0, out, 0)) {
+		close(fd);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (close(fd) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+#else
+	FILE* f = fopen(filepath, "wb");
+
+	if (f == NULL) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	for (size_t i = 0; i < segments->count; i++) {
+		_CConfSegment* segment = &segments->items[i];
+
+		if (fwrite(_cconf_segment_data(segment, data, 0, out), 1, segment->len, f) != segment->len) {
+			fclose(f);
+			return CCONF_STATUS_FWRITE;
+		}
+	}
+
+	if (fclose(f) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+#endif
+}
+
+// Appends to the end of a file
+static inline CCONF_STATUS _cconf_append_file(const char* filepath, const char* data, size_t len) {
+#ifdef _CCONF_POSIX
+	int fd = open(filepath, O_WRONLY | O_CREAT | O_APPEND, 0666);
+
+	if (fd < 0) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	if (!_cconf_write_all(fd, data, len)) {
+		close(fd);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (close(fd) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+#else
+	FILE* f = fopen(filepath, "ab");
+
+	if (f == NULL) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	if (fwrite(data, 1, len, f) != len) {
+		fclose(f);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (fclose(f) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+#endif
+}
+
+#ifdef _CCONF_IN_PLACE
+// Overwrites a file starting from `from`, where the new contents first
+// differ from the old ones, and truncates it to its new size
+static inline CCONF_STATUS _cconf_patch_segments(
+	const char* filepath,
+	_CConfSegment_da* segments,
+	const char* data,
+	size_t base,
+	const _CConfOutput* out,
+	size_t from,
+	size_t size
+) {
+	int fd = open(filepath, O_WRONLY);
+
+	if (fd < 0) {
+		return CCONF_STATUS_FOPEN;
+	}
+
+	if (lseek(fd, (off_t)from, SEEK_SET) < 0) {
+		close(fd);
+		return CCONF_STATUS_FSEEK;
+	}
+
+	if (!_cconf_writev_segments(fd, segments, data, base, out, from)) {
+		close(fd);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		return CCONF_STATUS_FWRITE;
+	}
+
+	if (close(fd) != 0) {
+		return CCONF_STATUS_FCLOSE;
+	}
+
+	return CCONF_STATUS_OK;
+}
+#endif
+
+#ifdef _CCONF_COPY_RANGE
+// Copies a range of a file into another one inside the kernel (or by
+// sharing the extents, on file systems that support reflinks)
+static inline bool _cconf_copy_range(int in, int out, off_t offset, size_t len) {
+	char* buf = NULL;
+	bool res = true;
+
+	while (len > 0) {
+		ssize_t copied = copy_file_range(in, &offset, out, NULL, len, 0);
+
+		if (copied > 0) {
+			len -= copied;
+			continue;
+		}
+
+		if (copied < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (copied == 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL && errno != EOPNOTSUPP)) {
+			return false;
+		}
+
+		break;
+	}
+
+	// Not supported between these files, copy through user space
+	while (len > 0 && res) {
+		size_t chunk = len < 65536 ? len : 65536;
+		ssize_t got;
+
+		if (buf == NULL && (buf = (char*)malloc(65536)) == NULL) {
+			return false;
+		}
+
+		got = pread(in, buf, chunk, offset);
+
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (got <= 0 || !_cconf_write_all(out, buf, got)) {
+			res = false;
+			break;
+		}
+
+		offset += got;
+		len -= got;
+	}
+
+	free(buf);
+	return res;
+}
+
+#endif
+
+#ifdef _CCONF_ATOMIC
+// Flushes the directory entry of a file to disk
+static inline bool _cconf_sync_dir(const char* filepath) {
+	const char* slash = strrchr(filepath, '/');
+	char* dirpath;
+	int fd;
+	bool res;
+
+	if (slash == NULL) {
+		fd = open(".", O_RDONLY);
+	}
+	else {
+		size_t len = slash == filepath ? 1 : (size_t)(slash - filepath);
+
+		if ((dirpath = (char*)malloc(len + 1)) == NULL) {
+			return false;
+		}
+
+		memcpy(dirpath, filepath, len);
+		dirpath[len] = 0;
+		fd = open(dirpath, O_RDONLY);
+		free(dirpath);
+	}
+
+	if (fd < 0) {
+		return false;
+	}
+
+	res = fsync(fd) == 0;
+	close(fd);
+
+	return res;
+}
+
+// Writes the segments into a new file that replaces the old one with a
+// rename. With `copy`, the unchanged spans are copied from the old file
+// without being read, and with `durable` both the new file and its
+// directory entry are flushed to disk before returning
+static inline CCONF_STATUS _cconf_replace_segments(
+	const char* filepath,
+	_CConfSegment_da* segments,
+	const char* data,
+	const _CConfOutput* out,
+	bool copy,
+	bool durable
+) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	size_t pathlen = strlen(filepath);
+	char* tmppath = (char*)malloc(pathlen + 8);
+	int in = -1;
+	int fd = -1;
+	struct stat st;
+
+	if (tmppath == NULL) {
+		return CCONF_STATUS_MALLOC;
+	}
+
+	memcpy(tmppath, filepath, pathlen);
+	memcpy(&tmppath[pathlen], ".XXXXXX", 8);
+
+	if (stat(filepath, &st) != 0) {
+		tmppath[0] = 0;
+		_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
+	}
+
+	fd = mkstemp(tmppath);
+
+	if (fd < 0) {
+		tmppath[0] = 0;
+		_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
+	}
+
+	fchmod(fd, st.st_mode & 07777);
+
+#ifdef _CCONF_COPY_RANGE
+	if (copy) {
+		if ((in = open(filepath, O_RDONLY)) < 0) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
+		}
+
+		for (size_t i = 0; i < segments->count; i++) {
+			_CConfSegment* segment = &segments->items[i];
+			bool ok = segment->unchanged ?
+				_cconf_copy_range(in, fd, (off_t)segment->offset, segment->len) :
+				_cconf_write_all(fd, &out->items[segment->offset], segment->len);
+
+			if (!ok) {
+				_CCONF_RETURN_DEFER(CCONF_STATUS_FWRITE);
+			}
+		}
+	}
+	else
+#else
+	(void)copy;
+#endif
+	if (!_cconf_writev_segments(fd, segments, data, 0, out, 0)) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_FWRITE);
+	}
+
+	if (durable && fsync(fd) != 0) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_FSYNC);
+	}
+
+	{
+		int tmp = fd;
+		fd = -1;
+
+		if (close(tmp) != 0) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FCLOSE);
+		}
+	}
+
+	if (rename(tmppath, filepath) != 0) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_FWRITE);
+	}
+
+	tmppath[0] = 0;
+
+	if (durable && !_cconf_sync_dir(filepath)) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_FSYNC);
+	}
+
+defer:
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	if (in >= 0) {
+		close(in);
+	}
+
+	if (tmppath[0] != 0) {
+		unlink(tmppath);
+	}
+
+	free(tmppath);
+	return status;
+}
+#endif
+
+static inline void _cconf_write_find_newlines(_CConf_size_t_da* arr, char* data, size_t datalen) {
+	char* start = data;
+	char* curr = data;
+
+	while ((data = (char*)memchr(data, '\n', datalen))) {
+		datalen -= (data - curr) + 1;
+		_CConf_size_t_da_append(arr, data - start);
+		data++;
+		curr = data;
+	}
+}
+
+static inline bool _cconf_stamp(const char* filepath, _CConfStamp* stamp) {
+	struct stat st;
+
+	if (stat(filepath, &st) != 0) {
+		return false;
+	}
+
+	stamp->size = (int64_t)st.st_size;
+	stamp->mtime = (int64_t)st.st_mtime;
+	stamp->dev = (int64_t)st.st_dev;
+	stamp->ino = (int64_t)st.st_ino;
+	stamp->taken = (int64_t)time(NULL);
+	stamp->hash = 0;
+	stamp->hashed = false;
+	return true;
+}
+
+// Returns whether the file on disk did not change since the last load or write
+static inline bool _cconf_stamp_valid(CConfFile* cconf) {
+	_CConfStamp stamp;
+
+	return _cconf_stamp(cconf->filepath, &stamp) &&
+		stamp.size == cconf->stamp.size &&
+		stamp.mtime == cconf->stamp.mtime &&
+		stamp.dev == cconf->stamp.dev &&
+		stamp.ino == cconf->stamp.ino;
+}
+
+static inline uint64_t _cconf_hash_content(const char* data, size_t len) {
+	uint64_t hash = 0x9E3779B97F4A7C15ull ^ len;
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v;
+		memcpy(&v, &data[i], 8);
+
+		hash = (hash ^ v) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+
+	for (; i < len; i++) {
+		hash = (hash ^ (uint8_t)data[i]) * 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+// Takes the ownership of `data`
+static inline void _cconf_cache_set(CConfFile* cconf, char* data, size_t len) {
+	if (cconf->newlines.items == NULL) {
+		_CConf_size_t_da_init(&cconf->newlines, 2);
+	}
+
+	if (cconf->data != data) {
+		free(cconf->data);
+	}
+
+	cconf->data = data;
+	cconf->len = len;
+	cconf->newlines.count = 0;
+	_cconf_write_find_newlines(&cconf->newlines, data, len);
+}
+
+static inline void _cconf_cache_free(CConfFile* cconf) {
+	free(cconf->data);
+	cconf->data = NULL;
+	cconf->len = 0;
+
+	if (cconf->newlines.items != NULL) {
+		_CConf_size_t_da_free(&cconf->newlines);
+	}
+}
+
+static inline size_t _cconf_count_newlines(const char* data, size_t len) {
+	const char* end = data + len;
+	size_t count = 0;
+
+	while ((data = (const char*)memchr(data, '\n', end - data)) != NULL) {
+		count++;
+		data++;
+	}
+
+	return count;
+}
+
+// Adds a size change to the field at `pos`, which moves all the following fields
+static inline void _cconf_spans_add(_CConfSpans* spans, size_t pos, int64_t bytes, int64_t lines) {
+	for (size_t i = pos + 1; i <= spans->count; i += i & (~i + 1)) {
+		spans->bytes[i] += bytes;
+		spans->lines[i] += lines;
+	}
+}
+
+// Sums the size changes of all the fields before `pos`
+static inline void _cconf_spans_query(const _CConfSpans* spans, size_t pos, int64_t* bytes, int64_t* lines) {
+	*bytes = 0;
+	*lines = 0;
+
+	for (size_t i = pos; i > 0; i -= i & (~i + 1)) {
+		*bytes += spans->bytes[i];
+		*lines += spans->lines[i];
+	}
+}
+
+static inline void _cconf_spans_free(_CConfSpans* spans) {
+	free(spans->bytes);
+	free(spans->lines);
+	memset(spans, 0, sizeof(_CConfSpans));
+}
+
+// Applies the pending size changes to every field
+static inline void _cconf_spans_flatten(CConfFile* cconf) {
+	_CConfSpans* spans = &cconf->spans;
+
+	for (size_t i = 0; i < spans->count; i++) {
+		CConfField* field = cconf->values.items[i];
+		int64_t bytes, lines;
+
+		if (field->start < 0) {
+			continue;
+		}
+
+		_cconf_spans_query(spans, i, &bytes, &lines);
+		field->start += bytes;
+		field->end += bytes;
+		field->startl += lines;
+		field->endl += lines;
+	}
+
+	_cconf_spans_free(spans);
+}
+
+// Same as _cconf_spans_flatten, and resizes the trees to the current
+// amount of fields
+static inline void _cconf_spans_rebuild(CConfFile* cconf) {
+	_CConfSpans* spans = &cconf->spans;
+
+	_cconf_spans_flatten(cconf);
+	spans->count = cconf->values.count;
+	spans->bytes = (int64_t*)calloc(spans->count + 1, sizeof(int64_t));
+	spans->lines = (int64_t*)calloc(spans->count + 1, sizeof(int64_t));
+}
+
+// Orders the inserted fields by the position of their anchor
+static inline int _cconf_insert_compare(const void* a, const void* b) {
+	const CConfField* x = *(CConfField* const*)a;
+	const CConfField* y = *(CConfField* const*)b;
+
+	if (x->anchor->pos != y->anchor->pos) {
+		return x->anchor->pos < y->anchor->pos ? -1 : 1;
+	}
+
+	return x->pos < y->pos ? -1 : (x->pos > y->pos);
+}
+
+static inline bool _cconf_is_inserted(const CConfField* field) {
+	return field->anchor != NULL && !field->removed;
+}
+
+// Collects the dirty inserted fields from `first` on, sorted by the
+// position of their anchor
+static inline void _cconf_collect_inserted(CConfFile* cconf, size_t first, pCConfField_da* inserted) {
+	for (size_t i = first; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->dirty && _cconf_is_inserted(field)) {
+			if (inserted->items == NULL) {
+				pCConfField_da_init(inserted, 8);
+			}
+
+			pCConfField_da_append(inserted, field);
+		}
+	}
+
+	if (inserted->count > 0) {
+		qsort(inserted->items, inserted->count, sizeof(CConfField*), _cconf_insert_compare);
+	}
+}
+
+// Moves the inserted fields to their place inside `values`, once they were
+// written at `placed`. All the offsets become absolute, so that the trees
+// are rebuilt for the new positions on the next write
+static inline CCONF_STATUS _cconf_values_reorder(CConfFile* cconf, pCConfField_da* inserted, CConfSpan* placed) {
+	CConfField** items = (CConfField**)malloc(cconf->values.count * sizeof(CConfField*));
+	size_t count = 0;
+	size_t k = 0;
+
+	if (items == NULL) {
+		return CCONF_STATUS_MALLOC;
+	}
+
+	_cconf_spans_flatten(cconf);
+
+	for (size_t i = 0; i < inserted->count; i++) {
+		CConfField* field = inserted->items[i];
+
+		field->start = placed[i].start;
+		field->end = placed[i].end;
+		field->startl = placed[i].startl;
+		field->endl = placed[i].endl;
+	}
+
+	// Both lists are already sorted by offset
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (_cconf_is_inserted(field)) {
+			continue;
+		}
+
+		while (k < inserted->count && inserted->items[k]->start < field->start) {
+			items[count++] = inserted->items[k++];
+		}
+
+		items[count++] = field;
+	}
+
+	while (k < inserted->count) {
+		items[count++] = inserted->items[k++];
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		items[i]->pos = i;
+		items[i]->anchor = NULL;
+	}
+
+	free(cconf->values.items);
+	cconf->values.items = items;
+	cconf->values.capacity = count;
+
+	return CCONF_STATUS_OK;
+}
+
+// Frees the replaced strings that are no longer read, and with `removed`
+// the ones of removed fields, as the fields are about to be freed
+static inline void _cconf_retired_sweep(CConfFile* cconf, bool removed) {
+	size_t count = 0;
+
+	for (size_t i = 0; i < cconf->retired.count; i++) {
+		_CConfRetired retired = cconf->retired.items[i];
+
+		if (_CCONF_LOAD(&retired.field->readers) == 0 || (removed && retired.field->removed)) {
+			cconf_string_free(retired.str);
+			continue;
+		}
+
+		cconf->retired.items[count++] = retired;
+	}
+
+	cconf->retired.count = count;
+}
+
+// Frees the removed fields, once they were written. Since the position
+// of the fields changes, the trees are rebuilt on the next write
+static inline void _cconf_values_compact(CConfFile* cconf) {
+	size_t count = 0;
+
+	_cconf_spans_flatten(cconf);
+	_cconf_retired_sweep(cconf, true);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->removed) {
+			_cconf_field_free(field);
+			continue;
+		}
+
+		field->pos = count;
+		cconf->values.items[count++] = field;
+	}
+
+	cconf->values.count = count;
+	cconf->removed = 0;
+}
+
+#define _CCONF_SWAR_BYTES(c) (0x0101010101010101ull * (uint8_t)(c))
+
+// Returns a mask with the high bit set in every byte of `v` equal to the
+// bytes of `pattern`. Unlike the usual zero byte trick, it is exact for
+// every byte, so that the matches can be counted.
+static inline uint64_t _cconf_swar_eq(uint64_t v, uint64_t pattern) {
+	uint64_t x = v ^ pattern;
+	uint64_t t = (x & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full;
+
+	return ~(t | x | 0x7F7F7F7F7F7F7F7Full);
+}
+
+static inline size_t _cconf_swar_count(uint64_t mask) {
+	return (size_t)(((mask >> 7) * 0x0101010101010101ull) >> 56);
+}
+
+// Escapes are found and newlines are counted eight bytes at a time,
+// while the runs without escapes are copied at once
+static inline size_t _cconf_write_string(CConfAs t, _CConfOutput* out) {
+	const char* p = t.str;
+	const char* end = p + CCONF_STRING_SIZE(t.str);
+	const char* run = p;
+	size_t res = 1;
+
+	_cconf_output_write(out, "\"", 1);
+
+	while (end - p >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+
+		uint64_t escapes =
+			_cconf_swar_eq(v, _CCONF_SWAR_BYTES('"')) |
+			_cconf_swar_eq(v, _CCONF_SWAR_BYTES('\\'));
+
+		res += _cconf_swar_count(_cconf_swar_eq(v, _CCONF_SWAR_BYTES('\n')));
+
+		if (escapes != 0) {
+			for (size_t i = 0; i < 8; i++) {
+				if (p[i] == '"' || p[i] == '\\') {
+					_cconf_output_write(out, run, &p[i] - run);
+					_cconf_output_write(out, "\\", 1);
+					run = &p[i];
+				}
+			}
+		}
+
+		p += 8;
+	}
+
+	for (; p < end; p++) {
+		if (*p == '\n') {
+			res++;
+		}
+		else if (*p == '"' || *p == '\\') {
+			_cconf_output_write(out, run, p - run);
+			_cconf_output_write(out, "\\", 1);
+			run = p;
+		}
+	}
+
+	_cconf_output_write(out, run, end - run);
+	_cconf_output_write(out, "\"", 1);
+	return res;
+}
+
+static const char _cconf_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// Writes the digits of `num` backwards, ending right before `end`.
+// Returns a pointer to the first digit.
+static inline char* _cconf_format_u64(uint64_t num, char* end) {
+	while (num >= 100) {
+		const char* pair = &_cconf_digit_pairs[(num % 100) * 2];
+		num /= 100;
+
+		*--end = pair[1];
+		*--end = pair[0];
+	}
+
+	if (num >= 10) {
+		*--end = _cconf_digit_pairs[num * 2 + 1];
+		*--end = _cconf_digit_pairs[num * 2];
+	}
+	else {
+		*--end = (char)('0' + num);
+	}
+
+	return end;
+}
+
+static inline size_t _cconf_write_number(CConfAs t, _CConfOutput* out) {
+	char buf[24];
+	char* end = &buf[sizeof(buf)];
+	uint64_t abs = t.num < 0 ? ~(uint64_t)t.num + 1 : (uint64_t)t.num;
+	char* p = _cconf_format_u64(abs, end);
+
+	if (t.num < 0) {
+		*--p = '-';
+	}
+
+	_cconf_output_write(out, p, end - p);
+	return 1;
+}
+
+// Same output as printf("%.1lf"): the value is rounded to the nearest
+// tenth, with ties to even, using the exact binary value of the double
+static inline size_t _cconf_write_decimal(CConfAs t, _CConfOutput* out) {
+	_Static_assert(sizeof(double) == sizeof(uint64_t), "Unsupported double");
+
+	char buf[32];
+	char* end = &buf[sizeof(buf)];
+	char* p;
+	uint64_t bits;
+	uint64_t mantissa;
+	int exponent;
+	uint64_t tenths;
+
+	memcpy(&bits, &t.dec, sizeof(bits));
+	exponent = (int)((bits >> 52) & 0x7FF);
+	mantissa = bits & ((1ull << 52) - 1);
+
+	if (exponent == 0x7FF) {
+		goto fallback;
+	}
+
+	if (exponent == 0) {
+		exponent = -1074;
+	}
+	else {
+		mantissa |= 1ull << 52;
+		exponent -= 1075;
+	}
+
+	// value * 10 = mantissa * 10 * 2^exponent, which fits in 57 bits
+	mantissa *= 10;
+
+	if (exponent >= 0) {
+		if (exponent > 6) {
+			goto fallback;
+		}
+
+		tenths = mantissa << exponent;
+	}
+	else if (exponent > -64) {
+		uint64_t rem = mantissa & ((1ull << -exponent) - 1);
+		uint64_t half = 1ull << (-exponent - 1);
+
+		tenths = mantissa >> -exponent;
+
+		if (rem > half || (rem == half && (tenths & 1))) {
+			tenths++;
+		}
+	}
+	else {
+		tenths = 0;
+	}
+
+	*--end = (char)('0' + tenths % 10);
+	*--end = '.';
+	p = _cconf_format_u64(tenths / 10, end);
+
+	if (bits >> 63) {
+		*--p = '-';
+	}
+
+	_cconf_output_write(out, p, &buf[sizeof(buf)] - p);
+	return 1;
+
+fallback:
+	{
+		char large[512];
+		int len = snprintf(large, sizeof(large), "%.1lf", t.dec);
+
+		_cconf_output_write(out, large, len);
+		return 1;
+	}
+}
+
+static inline size_t _cconf_write_boolean(CConfAs t, _CConfOutput* out) {
+	if (t.boolean) {
+		_cconf_output_write(out, "true", 4);
+	}
+	else {
+		_cconf_output_write(out, "false", 5);
+	}
+
+	return 1;
+}
+
+static inline size_t _cconf_write_array(CConfAs_da arr, _CConfOutput* out, size_t(*writer)(CConfAs, _CConfOutput*)) {
+	size_t res = 1;
+
+	_cconf_output_write(out, "[", 1);
+
+	for (size_t i = 0; i < arr.count; i++) {
+		res += writer(arr.items[i], out) - 1;
+
+		if (i != arr.count - 1) {
+			_cconf_output_write(out, ",", 1);
+		}
+	}
+
+	_cconf_output_write(out, "]", 1);
+	return res;
+}
+
+static inline size_t _cconf_write_value(CConfField* field, _CConfOutput* out) {
+	_Static_assert(CCONF_TYPE_AMOUNT == 8, "Incorrect type amount");
+
+	size_t ret;
+
+	switch (field->type) {
+	case CCONF_TYPE_STRING:
+		ret = _cconf_write_string(field->as, out);
+		break;
+	case CCONF_TYPE_NUMBER:
+		ret = _cconf_write_number(field->as, out);
+		break;
+	case CCONF_TYPE_DECIMAL:
+		ret = _cconf_write_decimal(field->as, out);
+		break;
+	case CCONF_TYPE_BOOLEAN:
+		ret = _cconf_write_boolean(field->as, out);
+		break;
+	case CCONF_TYPE_STRING_ARR:
+		ret = _cconf_write_array(field->arr, out, _cconf_write_string);
+		break;
+	case CCONF_TYPE_NUMBER_ARR:
+		ret = _cconf_write_array(field->arr, out, _cconf_write_number);
+		break;
+	case CCONF_TYPE_DECIMAL_ARR:
+		ret = _cconf_write_array(field->arr, out, _cconf_write_decimal);
+		break;
+	case CCONF_TYPE_BOOLEAN_ARR:
+		ret = _cconf_write_array(field->arr, out, _cconf_write_boolean);
+		break;
+	default:
+		assert(0 && "Unreachable");
+	}
+
+	return ret;
+}
+
+static inline size_t _cconf_write_field(CConfField* field, _CConfOutput* out) {
+	size_t ret;
+	_cconf_output_write(out, field->fieldname, CCONF_STRING_SIZE(field->fieldname));
+	_cconf_output_write(out, "=", 1);
+
+	ret = _cconf_write_value(field, out);
+
+	_cconf_output_write(out, "\n", 1);
+	return ret;
+}
+
+// Sets the location of the value of a field formatted by _cconf_write_field()
+static inline void _cconf_write_value_span(CConfField* field, size_t size, size_t lines) {
+	field->value.start = CCONF_STRING_SIZE(field->fieldname) + 1;
+	field->value.end = size - 1;
+	field->value.startl = 0;
+	field->value.endl = lines - 1;
+}
+
+// Compares the old text of an array element, from `s` up to `e`, with
+// its current value. Elements whose old text has a different type never
+// match, so that changing the type of an array rewrites all of them.
+static inline bool _cconf_splice_equal(uint8_t type, const char* s, const char* e, CConfAs value) {
+	char buf[64];
+	size_t len = e - s;
+
+	switch (type) {
+	case CCONF_TYPE_STRING_ARR:
+		{
+			size_t size = CCONF_STRING_SIZE(value.str);
+			size_t j = 0;
+
+			if (len < 2 || (*s != '"' && *s != '\'')) {
+				return false;
+			}
+
+			for (const char* p = s + 1; p < e - 1; p++) {
+				if (*p == '\\') {
+					p++;
+				}
+
+				if (j == size || value.str[j++] != *p) {
+					return false;
+				}
+			}
+
+			return j == size;
+		}
+
+	case CCONF_TYPE_NUMBER_ARR:
+	case CCONF_TYPE_DECIMAL_ARR:
+		if (len >= sizeof(buf) || (memchr(s, '.', len) != NULL) != (type == CCONF_TYPE_DECIMAL_ARR)) {
+			return false;
+		}
+
+		memcpy(buf, s, len);
+		buf[len] = 0;
+
+		if (type == CCONF_TYPE_NUMBER_ARR) {
+			return (*s == '-' || *s == '+' || isdigit(*s)) && strtoll(buf, NULL, 10) == value.num;
+		}
+
+		return strtod(buf, NULL) == value.dec;
+
+	case CCONF_TYPE_BOOLEAN_ARR:
+		return (len == 4 && memcmp(s, "true", 4) == 0 && value.boolean) ||
+			(len == 5 && memcmp(s, "false", 5) == 0 && !value.boolean);
+
+	default:
+		return false;
+	}
+}
+
+// Finds the next element inside the old text of an array, from `*p` up to
+// `end`, skipping separators and comments. Returns false once the closing
+// square bracket is reached.
+static inline bool _cconf_splice_next(const char** p, const char* end, const char** s, const char** e) {
+	const char* q = *p;
+
+	while (q < end) {
+		if (*q == CCONF_COMMENT) {
+			if ((q = (const char*)memchr(q, '\n', end - q)) == NULL) {
+				return false;
+			}
+		}
+		else if (*q != ',' && *q != '\n' && !_cconf_isspace(*q)) {
+			break;
+		}
+
+		q++;
+	}
+
+	if (q >= end || *q == ']') {
+		return false;
+	}
+
+	*s = q;
+
+	if (*q == '"' || *q == '\'') {
+		char d = *q++;
+
+		while (q < end && *q != d) {
+			if (*q == '\\') {
+				q++;
+			}
+
+			q++;
+		}
+
+		if (q >= end) {
+			return false;
+		}
+
+		q++;
+	}
+	else {
+		while (q < end && *q != ',' && *q != ']' && *q != '\n' && *q != CCONF_COMMENT && !_cconf_isspace(*q)) {
+			q++;
+		}
+	}
+
+	*e = q;
+	*p = q;
+	return true;
+}
+
+// Emits the new text of the value of a dirty field in place of its old
+// text, which is `len` bytes at `offset` inside the old contents of the
+// file. The elements of an array that did not change keep their old text,
+// as long as `data` holds it, along with the separators and comments
+// around them; anything else is formatted again. Returns the amount of
+// lines of the new text, and stores its size inside `size`.
+static inline size_t _cconf_write_splice(
+	CConfField* field,
+	const char* data,
+	size_t base,
+	size_t offset,
+	size_t len,
+	_CConfSegment_da* segments,
+	_CConfOutput* out,
+	size_t* size
+) {
+	size_t (*writer)(CConfAs, _CConfOutput*) = NULL;
+	const char* text = data != NULL ? &data[offset - base] : NULL;
+
+	switch (field->type) {
+	case CCONF_TYPE_STRING_ARR:
+		writer = _cconf_write_string;
+		break;
+	case CCONF_TYPE_NUMBER_ARR:
+		writer = _cconf_write_number;
+		break;
+	case CCONF_TYPE_DECIMAL_ARR:
+		writer = _cconf_write_decimal;
+		break;
+	case CCONF_TYPE_BOOLEAN_ARR:
+		writer = _cconf_write_boolean;
+		break;
+	}
+
+	if (writer != NULL && text != NULL && field->arr.count > 0 && len > 0 && text[0] == '[') {
+		const char* p = text + 1;
+		const char* end = text + len;
+		const char* s;
+		const char* e;
+		int64_t lines = field->value.endl - field->value.startl + 1;
+		size_t cursor = offset;
+		size_t i = 0;
+
+		*size = len;
+
+		for (; _cconf_splice_next(&p, end, &s, &e); i++) {
+			if (i >= field->arr.count || _cconf_splice_equal(field->type, s, e, field->arr.items[i])) {
+				continue;
+			}
+
+			size_t old_count = out->count;
+			size_t new_lines = writer(field->arr.items[i], out);
+			size_t new_size = out->count - old_count;
+
+			_cconf_segment_add(segments, true, cursor, (s - text) + offset - cursor);
+			_cconf_segment_add(segments, false, old_count, new_size);
+			cursor = (e - text) + offset;
+
+			lines += (int64_t)new_lines - 1 - (int64_t)_cconf_count_newlines(s, e - s);
+			*size += new_size - (e - s);
+		}
+
+		if (i > 0) {
+			// End of the last element that is kept, and of the last one
+			size_t last = (e - text) + offset;
+
+			if (i > field->arr.count) {
+				size_t kept;
+				size_t dropped;
+
+				// Found again, the loop above stops at the last element
+				p = text + 1;
+
+				for (size_t j = 0; j < field->arr.count && _cconf_splice_next(&p, end, &s, &e); j++) {
+				}
+
+				kept = (e - text) + offset;
+				dropped = last - kept;
+
+				_cconf_segment_add(segments, true, cursor, kept - cursor);
+				lines -= _cconf_count_newlines(&text[kept - offset], dropped);
+				*size -= dropped;
+				cursor = last;
+			}
+			else if (i < field->arr.count) {
+				_cconf_segment_add(segments, true, cursor, last - cursor);
+				cursor = last;
+
+				for (size_t j = i; j < field->arr.count; j++) {
+					size_t old_count = out->count;
+					_cconf_output_write(out, ",", 1);
+					lines += writer(field->arr.items[j], out) - 1;
+					_cconf_segment_add(segments, false, old_count, out->count - old_count);
+					*size += out->count - old_count;
+				}
+			}
+
+			_cconf_segment_add(segments, true, cursor, offset + len - cursor);
+			return lines;
+		}
+	}
+
+	size_t old_count = out->count;
+	size_t lines = _cconf_write_value(field, out);
+
+	*size = out->count - old_count;
+	_cconf_segment_add(segments, false, old_count, *size);
+	return lines;
+}
+
+//// Exported functions
+ 
+// String functions
+
+CCONFDEF CConfString* cconf_string_from_size(CConfStringSize len) {
+	CConfString* res = (CConfString*)malloc(
+		(sizeof(CConfStringSize)) +
+		len + 1
+	);
+
+	*((CConfStringSize*)res) = len;
+	return (CConfString*)(((CConfStringSize*)res) + 1);
+}
+
+CCONFDEF CConfString* cconf_string_new(const char* s) {
+	size_t len = strlen(s);
+	CConfString* res = cconf_string_from_size(len);
+	size_t i = 0;
+
+	do {
+		res[i++] = *s;
+	} while (*(s++));
+
+	return res;
+}
+
+CCONFDEF CConfString* cconf_string_from_sized_string(const char* s, CConfStringSize len) {
+	CConfString* res = cconf_string_from_size(len);
+	memcpy(res, s, len);
+	res[CCONF_STRING_SIZE(res)] = 0;
+	return res;
+}
+
+CCONFDEF void cconf_string_free(CConfString* s) {
+	free(((CConfStringSize*)s) - 1);
+}
+
+// CConf main functions
+
+CCONFDEF CConfFile cconf_init(void) {
+	CConfFile cconf = { 0 };
+	return cconf;
+}
+
+CCONFDEF void cconf_free(CConfFile* cconf) {
+	free(cconf->filepath);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		_cconf_field_free(cconf->values.items[i]);
+	}
+
+	pCConfField_da_free(&cconf->values);
+	_cconf_cache_free(cconf);
+	_cconf_spans_free(&cconf->spans);
+
+	for (size_t i = 0; i < cconf->retired.count; i++) {
+		cconf_string_free(cconf->retired.items[i].str);
+	}
+
+	_CConfRetired_da_free(&cconf->retired);
+}
+
+// Appends the fields that are only inside the journal
+static inline CCONF_STATUS _cconf_journal_append_rest(
+	CConfFile* cconf,
+	_CConfJournal* journal,
+	CCONF_HANDLER* handler,
+	void* user,
+	CCONF_SELECTOR* selector,
+	void* selector_user
+) {
+	for (size_t i = 0; i < journal->records.count; i++) {
+		CConfField* record = journal->records.items[i];
+
+		if (record == NULL || record->journaled) {
+			continue;
+		}
+
+		journal->records.items[i] = NULL;
+
+		if (selector != NULL) {
+			uint8_t select = selector(record->fieldname, CCONF_STRING_SIZE(record->fieldname), selector_user);
+
+			if (select != CCONF_SELECT_LOAD && select != CCONF_SELECT_LAST) {
+				_cconf_field_free(record);
+				continue;
+			}
+		}
+
+		if (!_cconf_journal_check(cconf->schema, record, &cconf->violation)) {
+			_cconf_field_free(record);
+			return CCONF_STATUS_SCHEMA;
+		}
+
+		cconf_append_field(cconf, record);
+		record->dirty = false;
+		record->journaled = true;
+
+		if (
+			(cconf->flags & CCONF_FLAG_INDEX_ARRAYS) &&
+			(record->type == CCONF_TYPE_STRING_ARR || record->type == CCONF_TYPE_NUMBER_ARR)
+		) {
+			cconf_array_index(record);
+		}
+
+		handler(record, user);
+	}
+
+	return CCONF_STATUS_OK;
+}
+
+// Records the state of the file that was just parsed, and keeps its
+// contents with CCONF_FLAG_KEEP_BUFFER. Takes the ownership of `data`.
+static inline void _cconf_load_finish(CConfFile* cconf, char* data, size_t len) {
+	if (!_cconf_stamp(cconf->filepath, &cconf->stamp)) {
+		memset(&cconf->stamp, 0, sizeof(_CConfStamp));
+	}
+	else if (cconf->flags & CCONF_FLAG_REBASE) {
+		cconf->stamp.hash = _cconf_hash_content(data, len);
+		cconf->stamp.hashed = true;
+	}
+
+	cconf->lines = _cconf_count_newlines(data, len);
+
+	if (cconf->flags & CCONF_FLAG_KEEP_BUFFER) {
+		_cconf_cache_set(cconf, data, len);
+	}
+	else {
+		free(data);
+	}
+}
+
+// Parses the contents of `cconf->filepath`, whose ownership is taken
+static inline CCONF_STATUS _cconf_load_data(
+	CConfFile* cconf,
+	_CConfLexer lexer,
+	CCONF_HANDLER* handler,
+	void* user,
+	CCONF_SELECTOR* selector,
+	void* selector_user
+) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	_CConfParser parser;
+	_CConfJournal journal = { 0 };
+
+	if (
+		(cconf->flags & CCONF_FLAG_JOURNAL) &&
+		(status = _cconf_journal_load(&journal, cconf->filepath)) != CCONF_STATUS_OK
+	) {
+		free(lexer.data);
+		return status;
+	}
+
+	if ((status = _cconf_parser_init(
+		&parser, &lexer,
+		cconf->flags, cconf->element_handler, user,
+		cconf->schema, &cconf->violation
+	)) != CCONF_STATUS_OK) {
+		_cconf_journal_free(&journal);
+		free(lexer.data);
+		return status;
+	}
+
+	parser.selector = selector;
+	parser.selector_user = selector_user;
+
+	if (cconf->flags & CCONF_FLAG_JOURNAL) {
+		parser.journal = &journal;
+	}
+
+	switch (_cconf_parse(cconf, &parser, handler)) {
+	case _CCONF_PARSE_SYNTAX:
+		if (cconf->flags & CCONF_FLAG_NO_EXIT) {
+			status = CCONF_STATUS_PARSE;
+			break;
+		}
+
+		_cconf_parser_expect_error(parser.expected, &parser.got);
+		break;
+
+	case _CCONF_PARSE_SCHEMA:
+		status = CCONF_STATUS_SCHEMA;
+		break;
+	}
+
+	_cconf_parser_free(&parser);
+
+	if ((cconf->flags & CCONF_FLAG_JOURNAL) && status == CCONF_STATUS_OK) {
+		status = _cconf_journal_append_rest(cconf, &journal, handler, user, selector, selector_user);
+	}
+
+	// A file that failed to load has no fields
+	if (status != CCONF_STATUS_OK) {
+		for (size_t i = 0; i < cconf->values.count; i++) {
+			_cconf_field_free(cconf->values.items[i]);
+		}
+
+		cconf->values.count = 0;
+	}
+
+	if (cconf->flags & CCONF_FLAG_JOURNAL) {
+		// An incomplete record is dropped by the next compaction
+		cconf->journal_size = journal.torn ? SIZE_MAX : journal.size;
+		cconf->journal_partial = selector != NULL;
+		_cconf_journal_free(&journal);
+	}
+
+	_cconf_load_finish(cconf, lexer.data, lexer.len);
+	return status;
+}
+
+static inline CCONF_STATUS _cconf_load(
+	CConfFile* cconf,
+	const char* filepath,
+	CCONF_HANDLER* handler,
+	void* user,
+	CCONF_SELECTOR* selector,
+	void* selector_user
+) {
+	_CConfLexer lexer;
+
+	if (cconf->values.items == NULL) {
+		pCConfField_da_init(&cconf->values, 2);
+	}
+	else {
+		cconf->values.count = 0;
+	}
+
+	_cconf_spans_free(&cconf->spans);
+
+	{
+		CCONF_STATUS read_status = _cconf_read_entire_file(filepath, &lexer.len, &lexer.data);
+
+		if (read_status != CCONF_STATUS_OK) {
+			return read_status;
+		}
+	}
+
+	cconf->filepath = (char*)malloc((strlen(filepath) + 1) * sizeof(char));
+	strcpy(cconf->filepath, filepath);
+
+	return _cconf_load_data(cconf, lexer, handler, user, selector, selector_user);
+}
+
+CCONFDEF CCONF_STATUS cconf_load(
+	CConfFile* cconf,
+	const char* filepath,
+	CCONF_HANDLER* handler,
+	void* user
+) {
+	return _cconf_load(cconf, filepath, handler, user, cconf->selector, user);
+}
+
+CCONFDEF CCONF_STATUS cconf_load_keys(
+	CConfFile* cconf,
+	const char* filepath,
+	const char* const* keys,
+	size_t count,
+	CCONF_HANDLER* handler,
+	void* user
+) {
+	_CConfKeySet set;
+	CCONF_STATUS status = _cconf_key_set_init(&set, keys, count);
+
+	if (status != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	status = _cconf_load(cconf, filepath, handler, user, _cconf_key_set_select, &set);
+	_cconf_key_set_free(&set);
+
+	return status;
+}
+
+// Length of the common prefix of two buffers, compared a block at a time
+static inline size_t _cconf_common_prefix(const char* a, const char* b, size_t len) {
+	size_t i = 0;
+
+	while (i + 4096 <= len && memcmp(&a[i], &b[i], 4096) == 0) {
+		i += 4096;
+	}
+
+	while (i < len && a[i] == b[i]) {
+		i++;
+	}
+
+	return i;
+}
+
+static inline size_t _cconf_common_suffix(const char* a, size_t a_len, const char* b, size_t b_len, size_t len) {
+	size_t i = 0;
+
+	while (i + 4096 <= len && memcmp(&a[a_len - i - 4096], &b[b_len - i - 4096], 4096) == 0) {
+		i += 4096;
+	}
+
+	while (i < len && a[a_len - i - 1] == b[b_len - i - 1]) {
+		i++;
+	}
+
+	return i;
+}
+
+// Amount of newlines before `offset` inside the kept buffer
+static inline size_t _cconf_line_of(CConfFile* cconf, size_t offset) {
+	size_t lo = 0;
+	size_t hi = cconf->newlines.count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (cconf->newlines.items[mid] < offset) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+// Whether the fields still describe the kept buffer exactly
+static inline bool _cconf_reload_possible(CConfFile* cconf) {
+	if (
+		cconf->data == NULL || cconf->removed != 0 || cconf->schema != NULL ||
+		cconf->selector != NULL || (cconf->flags & CCONF_FLAG_JOURNAL)
+	) {
+		return false;
+	}
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		const CConfField* field = cconf->values.items[i];
+
+		if (field->dirty || field->start < 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+typedef struct {
+	const char* data;
+	size_t end;
+} _CConfRegion;
+
+// Whether the lines from `from` up to `to` are empty or comments
+static inline bool _cconf_only_comments(const char* data, size_t from, size_t to) {
+	size_t i = from;
+
+	while (i < to) {
+		while (i < to && _cconf_isspace(data[i])) {
+			i++;
+		}
+
+		if (i < to && data[i] != '\n' && data[i] != CCONF_COMMENT) {
+			return false;
+		}
+
+		const char* newline = (const char*)memchr(&data[i], '\n', to - i);
+
+		if (newline == NULL) {
+			break;
+		}
+
+		i = (size_t)(newline - data) + 1;
+	}
+
+	return true;
+}
+
+// Stops at the first field after the region
+static inline uint8_t _cconf_region_select(const char* name, size_t len, void* user) {
+	_CConfRegion* region = (_CConfRegion*)user;
+	(void)len;
+
+	return (size_t)(name - region->data) < region->end ? CCONF_SELECT_LOAD : CCONF_SELECT_STOP;
+}
+
+// Parses again the fields around the part of the file that differs from the
+// kept buffer, and moves the fields that follow. Returns false, without
+// changing anything, when the whole file has to be parsed again.
+static inline bool _cconf_reload_region(
+	CConfFile* cconf,
+	char* data,
+	size_t len,
+	CCONF_HANDLER* handler,
+	void* user
+) {
+	const char* old = cconf->data;
+	size_t old_len = cconf->len;
+	size_t limit = old_len < len ? old_len : len;
+	size_t prefix = _cconf_common_prefix(old, data, limit);
+	size_t suffix = _cconf_common_suffix(old, old_len, data, len, limit - prefix);
+
+	if (prefix == old_len && old_len == len) {
+		_cconf_load_finish(cconf, data, len);
+		return true;
+	}
+
+	// The changed bytes are widened to whole lines, so that both ends are
+	// the start of a line inside both buffers
+	size_t start = prefix;
+	size_t end = old_len - suffix;
+	size_t new_end = len - suffix;
+
+	while (start > 0 && old[start - 1] != '\n') {
+		start--;
+	}
+
+	bool line_end = new_end == start || (
+		(end == 0 || old[end - 1] == '\n') && (new_end == 0 || data[new_end - 1] == '\n')
+	);
+
+	if (end < old_len && !line_end) {
+		const char* newline = (const char*)memchr(&old[end], '\n', old_len - end);
+		end = newline == NULL ? old_len : (size_t)(newline - old) + 1;
+	}
+
+	// Then to whole fields, as a field can span multiple lines
+	size_t first = 0;
+	size_t last;
+	size_t hi = cconf->values.count;
+
+	while (first < hi) {
+		size_t mid = first + (hi - first) / 2;
+
+		if ((size_t)cconf->values.items[mid]->end <= start) {
+			first = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	// A field that ended with the file can go on with the new contents
+	if (first > 0 && (size_t)cconf->values.items[first - 1]->end == old_len) {
+		first--;
+	}
+
+	for (last = first; last < cconf->values.count; last++) {
+		if ((size_t)cconf->values.items[last]->start >= end) {
+			break;
+		}
+	}
+
+	if (last > first) {
+		if ((size_t)cconf->values.items[first]->start < start) {
+			start = cconf->values.items[first]->start;
+		}
+
+		if ((size_t)cconf->values.items[last - 1]->end > end) {
+			end = cconf->values.items[last - 1]->end;
+		}
+	}
+
+	// The lines before the region must only hold comments, otherwise
+	// they are part of a value that was not closed
+	if (!_cconf_only_comments(cconf->data, first > 0 ? cconf->values.items[first - 1]->end : 0, start)) {
+		return false;
+	}
+
+	// And so must the lines after it, as the old contents could have
+	// ended with a value that was not closed
+	if (!_cconf_only_comments(cconf->data, end, last < cconf->values.count ? (size_t)cconf->values.items[last]->start : old_len)) {
+		return false;
+	}
+
+	new_end = end + len - old_len;
+	_CConfLexer lexer = { 0 };
+	_CConfParser parser;
+	_CConfRegion region = { data, new_end };
+	pCConfField_da parsed;
+	uint8_t res;
+
+	// The whole file is lexed, as a value or a comment could go on
+	// after the region with the new contents
+	lexer.data = data;
+	lexer.len = len;
+
+	if (_cconf_parser_init(
+		&parser, &lexer,
+		cconf->flags, cconf->element_handler, user,
+		NULL, &cconf->violation
+	) != CCONF_STATUS_OK) {
+		return false;
+	}
+
+	parser.lexer.pos = start;
+	parser.lexer.row = _cconf_line_of(cconf, start);
+	parser.selector = _cconf_region_select;
+	parser.selector_user = &region;
+	pCConfField_da_init(&parsed, 4);
+	res = _CCONF_PARSE_EOF;
+
+	// Lines were only removed
+	while (start < new_end) {
+		CConfField* field = (CConfField*)malloc(sizeof(CConfField));
+		res = _cconf_parse_field(&parser, field);
+
+		if (res != _CCONF_PARSE_FIELD) {
+			free(field);
+			break;
+		}
+
+		pCConfField_da_append(&parsed, field);
+
+		if ((size_t)field->end > new_end) {
+			res = _CCONF_PARSE_SYNTAX;
+			break;
+		}
+	}
+
+	_cconf_parser_free(&parser);
+
+	// Without a field after the region, the rest of the file must only
+	// hold comments, as the region can start a value that is not closed
+	if (res == _CCONF_PARSE_EOF && !parser.stopped && start < new_end) {
+		size_t from = parsed.count > 0 ? (size_t)parsed.items[parsed.count - 1]->end : start;
+
+		if (last < cconf->values.count || !_cconf_only_comments(data, from, len)) {
+			res = _CCONF_PARSE_SYNTAX;
+		}
+	}
+
+	// Errors are reported by the parse of the whole file, which also
+	// handles the fields that do not end inside the region
+	if (res != _CCONF_PARSE_EOF) {
+		for (size_t i = 0; i < parsed.count; i++) {
+			_cconf_field_free(parsed.items[i]);
+		}
+
+		pCConfField_da_free(&parsed);
+		return false;
+	}
+
+	int64_t bytes = (int64_t)len - (int64_t)old_len;
+	int64_t lines = (int64_t)_cconf_count_newlines(&data[start], new_end - start) -
+		(int64_t)_cconf_count_newlines(&old[start], end - start);
+	size_t count = cconf->values.count - (last - first) + parsed.count;
+
+	// The strings replaced in the fields that are parsed again go with them
+	for (size_t i = first; i < last; i++) {
+		cconf->values.items[i]->removed = true;
+	}
+
+	_cconf_retired_sweep(cconf, true);
+
+	for (size_t i = first; i < last; i++) {
+		_cconf_field_free(cconf->values.items[i]);
+	}
+
+	if (count > cconf->values.capacity) {
+		cconf->values.capacity = count * 2;
+		cconf->values.items = (CConfField**)realloc(
+			cconf->values.items, cconf->values.capacity * sizeof(CConfField*)
+		);
+	}
+
+	memmove(
+		&cconf->values.items[first + parsed.count],
+		&cconf->values.items[last],
+		(cconf->values.count - last) * sizeof(CConfField*)
+	);
+	memcpy(&cconf->values.items[first], parsed.items, parsed.count * sizeof(CConfField*));
+	cconf->values.count = count;
+
+	for (size_t i = first; i < count; i++) {
+		CConfField* field = cconf->values.items[i];
+		field->pos = i;
+
+		if (i >= first + parsed.count) {
+			field->start += bytes;
+			field->end += bytes;
+			field->startl += lines;
+			field->endl += lines;
+		}
+	}
+
+	for (size_t i = 0; i < parsed.count; i++) {
+		handler(parsed.items[i], user);
+	}
+
+	pCConfField_da_free(&parsed);
+	_cconf_load_finish(cconf, data, len);
+	return true;
+}
+
+// Loads the configuration file again. With CCONF_FLAG_KEEP_BUFFER, only the
+// fields around the changed part of the file are parsed again.
+CCONFDEF CCONF_STATUS cconf_reload(CConfFile* cconf, CCONF_HANDLER* handler, void* user) {
+	_CConfLexer lexer;
+	CCONF_STATUS status = _cconf_read_entire_file(cconf->filepath, &lexer.len, &lexer.data);
+
+	if (status != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	_cconf_retired_sweep(cconf, false);
+	_cconf_spans_flatten(cconf);
+
+	if (_cconf_reload_possible(cconf) && _cconf_reload_region(cconf, lexer.data, lexer.len, handler, user)) {
+		return CCONF_STATUS_OK;
+	}
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		cconf->values.items[i]->removed = true;
+	}
+
+	_cconf_retired_sweep(cconf, true);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		_cconf_field_free(cconf->values.items[i]);
+	}
+
+	cconf->values.count = 0;
+	cconf->removed = 0;
+	cconf->pending = false;
+
+	return _cconf_load_data(cconf, lexer, handler, user, cconf->selector, user);
+}
+
+CCONFDEF CConfField *cconf_field_new(CConfString *fieldname, uint8_t type) {
+	// The field is not inside the file until it is written
+	CConfField *field = (CConfField*)calloc(1, sizeof(CConfField));
+	field->fieldname = fieldname;
+	field->type = type;
+	_cconf_field_unplace(field);
+	return field;
+}
+
+CCONFDEF void cconf_field_clear(CConfField* field) {
+	_cconf_field_clear(field);
+}
+
+CCONFDEF void cconf_append_field(CConfFile *cconf, CConfField *field) {
+	field->dirty = true;
+	field->journaled = false;
+	field->removed = false;
+	field->anchor = NULL;
+	_cconf_field_unplace(field);
+	field->pos = cconf->values.count;
+	pCConfField_da_append(&cconf->values, field);
+}
+
+CCONFDEF void cconf_insert_field(CConfFile* cconf, CConfField* after, CConfField* field) {
+	cconf_append_field(cconf, field);
+
+	// Fields that were not written yet have no place inside the file
+	while (after != NULL && after->start < 0) {
+		after = after->anchor;
+	}
+
+	field->anchor = after;
+}
+
+CCONFDEF void cconf_remove_field(CConfFile* cconf, CConfField* field) {
+	if (field->removed) {
+		return;
+	}
+
+	field->removed = true;
+	field->dirty = true;
+	cconf->removed++;
+}
+
+CCONFDEF CConfSpan cconf_field_span(CConfFile* cconf, CConfField* field) {
+	CConfSpan span = { field->start, field->end, field->startl, field->endl };
+
+	if (field->start >= 0 && field->pos < cconf->spans.count) {
+		int64_t bytes, lines;
+		_cconf_spans_query(&cconf->spans, field->pos, &bytes, &lines);
+
+		span.start += bytes;
+		span.end += bytes;
+		span.startl += lines;
+		span.endl += lines;
+	}
+
+	return span;
+}
+
+// Emits the segments that replace the text of a dirty field, from `start`
+// up to `end` inside the old contents of the file, and moves `last` past
+// it. Removed fields are replaced by nothing, while the fields that were
+// loaded only have their value replaced, keeping the text around it
+// (spacing and trailing comments). Nothing is changed inside the field.
+static inline void _cconf_write_dirty(
+	CConfField* field,
+	const char* data,
+	size_t base,
+	size_t start,
+	size_t end,
+	_CConfSegment_da* segments,
+	_CConfOutput* out,
+	size_t* last,
+	int64_t* new_size,
+	int64_t* new_lines
+) {
+	if (field->removed || field->value.start < 0) {
+		size_t old_count = out->count;
+
+		_cconf_segment_add(segments, true, *last, start - *last);
+
+		*new_lines = field->removed ? 0 : _cconf_write_field(field, out);
+		*new_size = out->count - old_count;
+
+		_cconf_segment_add(segments, false, old_count, *new_size);
+		*last = end;
+		return;
+	}
+
+	size_t value_start = start + field->value.start;
+	size_t value_end = start + field->value.end;
+	size_t value_size;
+
+	_cconf_segment_add(segments, true, *last, value_start - *last);
+
+	size_t value_lines = _cconf_write_splice(
+		field, data, base,
+		value_start, value_end - value_start,
+		segments, out, &value_size
+	);
+
+	*new_size = (int64_t)(end - start) + value_size - (value_end - value_start);
+	*new_lines = (field->endl - field->startl + 1) + (int64_t)value_lines - (field->value.endl - field->value.startl + 1);
+	*last = value_end;
+}
+
+// Replaces the text of a dirty field, or removes it. The changes made by
+// this write are already in the trees, but the segments refer to the old
+// contents, so `change` is subtracted from the offsets
+static inline void _cconf_write_replace(
+	CConfFile* cconf,
+	size_t i,
+	const char* data,
+	size_t base,
+	_CConfSegment_da* segments,
+	_CConfOutput* out,
+	size_t* last,
+	int64_t* change,
+	int64_t* line_change
+) {
+	CConfField* field = cconf->values.items[i];
+	int64_t bytes, lines;
+	int64_t new_size, new_lines;
+
+	field->dirty = false;
+
+	_cconf_spans_query(&cconf->spans, i, &bytes, &lines);
+	size_t start = field->start + bytes - *change;
+	size_t end = field->end + bytes - *change;
+
+	_cconf_write_dirty(field, data, base, start, end, segments, out, last, &new_size, &new_lines);
+
+	int64_t delta = new_size - (int64_t)(end - start);
+	int64_t line_delta = new_lines - (field->endl - field->startl + 1);
+
+	if (field->value.start < 0) {
+		_cconf_write_value_span(field, new_size, new_lines);
+	}
+	else {
+		field->value.end += delta;
+		field->value.endl += line_delta;
+	}
+
+	field->end = field->start + new_size;
+	field->endl = field->startl + new_lines - 1;
+
+	_cconf_spans_add(&cconf->spans, i, delta, line_delta);
+	*change += delta;
+	*line_change += line_delta;
+}
+
+// Builds the text that _cconf_write() would write over `data`, the current
+// contents of the file, without changing any field or span
+static inline void _cconf_patch_text(CConfFile* cconf, const char* data, size_t len, _CConfOutput* out) {
+	pCConfField_da inserted = { 0 };
+	_CConfSegment_da segments = { 0 };
+	_CConfOutput text = { 0 };
+	size_t last = 0;
+	size_t i;
+	size_t k = 0;
+	int64_t new_size, new_lines;
+
+	_cconf_collect_inserted(cconf, 0, &inserted);
+	_CConfSegment_da_init(&segments, 8);
+
+	for (i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->dirty && field->start < 0) {
+			break;
+		}
+
+		CConfSpan span = cconf_field_span(cconf, field);
+
+		// The file may not match the fields anymore
+		if ((size_t)span.end > len) {
+			break;
+		}
+
+		if (field->dirty) {
+			_cconf_write_dirty(field, data, 0, span.start, span.end, &segments, &text, &last, &new_size, &new_lines);
+		}
+
+		if (k < inserted.count && inserted.items[k]->anchor == field) {
+			_cconf_segment_add(&segments, true, last, span.end - last);
+			last = span.end;
+
+			for (; k < inserted.count && inserted.items[k]->anchor == field; k++) {
+				size_t old_count = text.count;
+
+				_cconf_write_field(inserted.items[k], &text);
+				_cconf_segment_add(&segments, false, old_count, text.count - old_count);
+			}
+		}
+	}
+
+	_cconf_segment_add(&segments, true, last, len - last);
+
+	for (size_t j = 0; j < segments.count; j++) {
+		_cconf_output_write(out, _cconf_segment_data(&segments.items[j], data, 0, &text), segments.items[j].len);
+	}
+
+	while (i < cconf->values.count && !(cconf->values.items[i]->dirty && cconf->values.items[i]->start < 0)) {
+		i++;
+	}
+
+	bool separated = i == 0;
+
+	for (; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->removed || _cconf_is_inserted(field)) {
+			continue;
+		}
+
+		if (!separated) {
+			_cconf_output_write(out, "\n", 1);
+			separated = true;
+		}
+
+		_cconf_write_field(field, out);
+	}
+
+	_CConfSegment_da_free(&segments);
+	_CConfOutput_free(&text);
+	free(inserted.items);
+}
+
+// Inserted fields are written after their anchor, in the order the next
+// write will place them
+CCONFDEF void cconf_serialize(CConfFile* cconf, CConfBuffer* buf) {
+	pCConfField_da inserted = { 0 };
+	size_t k = 0;
+
+	_cconf_collect_inserted(cconf, 0, &inserted);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (_cconf_is_inserted(field)) {
+			continue;
+		}
+
+		if (!field->removed) {
+			_cconf_write_field(field, buf);
+		}
+
+		for (; k < inserted.count && inserted.items[k]->anchor == field; k++) {
+			_cconf_write_field(inserted.items[k], buf);
+		}
+	}
+
+	free(inserted.items);
+}
+
+CCONFDEF CCONF_STATUS cconf_serialize_patched(CConfFile* cconf, CConfBuffer* buf) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	size_t len = 0;
+	char* data = NULL;
+
+	if (cconf->spans.count != cconf->values.count) {
+		_cconf_spans_rebuild(cconf);
+
+		if (cconf->spans.bytes == NULL || cconf->spans.lines == NULL) {
+			return CCONF_STATUS_MALLOC;
+		}
+	}
+
+	if (_cconf_stamp_valid(cconf) && cconf->data != NULL) {
+		_cconf_patch_text(cconf, cconf->data, cconf->len, buf);
+		return CCONF_STATUS_OK;
+	}
+
+	if ((status = _cconf_read_entire_file(cconf->filepath, &len, &data)) != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	_cconf_patch_text(cconf, data, len, buf);
+	free(data);
+
+	return status;
+}
+
+CCONFDEF void cconf_buffer_free(CConfBuffer* buf) {
+	_CConfOutput_free(buf);
+}
+
+// Milliseconds from an arbitrary point in time
+static inline int64_t _cconf_now(void) {
+#if defined(_CCONF_POSIX) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	}
+#endif
+
+	return (int64_t)time(NULL) * 1000;
+}
+
+// Whether the writes asked by the flags can be done, a write that is
+// not crash safe must not take the place of an atomic one
+static inline bool _cconf_write_supported(CConfFile* cconf) {
+#ifdef _CCONF_ATOMIC
+	(void)cconf;
+	return true;
+#else
+	return !(cconf->flags & CCONF_FLAG_ATOMIC_WRITE);
+#endif
+}
+
+static inline CCONF_STATUS _cconf_write(CConfFile* cconf) {
+	if (!_cconf_write_supported(cconf)) {
+		return CCONF_STATUS_UNSUPPORTED;
+	}
+
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	size_t len;
+	size_t size = 0;
+	char* data = NULL;
+	_CConfOutput out = { 0 };
+	_CConfSegment_da segments = { 0 };
+	bool valid = _cconf_stamp_valid(cconf);
+	bool cached = valid && cconf->data != NULL;
+	bool copy = false;
+	bool in_place = false;
+	bool append = false;
+	size_t base_lines = cconf->lines;
+	size_t first = 0;
+
+	// Offset of `data` inside the old contents of the file
+	size_t base = 0;
+
+	// Fields inserted after another one, sorted by their place in the file
+	pCConfField_da inserted = { 0 };
+	CConfSpan* placed = NULL;
+
+	while (first < cconf->values.count && !cconf->values.items[first]->dirty) {
+		first++;
+	}
+
+	_cconf_collect_inserted(cconf, first, &inserted);
+
+	if (inserted.count > 0 && (placed = (CConfSpan*)malloc(inserted.count * sizeof(CConfSpan))) == NULL) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
+	}
+
+	bool atomic = false;
+
+#ifdef _CCONF_ATOMIC
+	atomic = (cconf->flags & CCONF_FLAG_ATOMIC_WRITE) != 0;
+#endif
+
+	// When only appended fields are dirty the old contents are not needed
+	append = valid && !atomic && inserted.count == 0 &&
+		(first == cconf->values.count || cconf->values.items[first]->start < 0) &&
+		(cached || !(cconf->flags & CCONF_FLAG_KEEP_BUFFER));
+
+#ifdef _CCONF_COPY_RANGE
+	// The unchanged spans are never read
+	copy = valid && !append && (cconf->flags & CCONF_FLAG_COPY_RANGE) && !(cconf->flags & CCONF_FLAG_KEEP_BUFFER);
+#endif
+
+#ifdef _CCONF_IN_PLACE
+	in_place = valid && !append && !copy && !atomic && (cconf->flags & CCONF_FLAG_WRITE_IN_PLACE);
+#endif
+
+	if (cconf->spans.count != cconf->values.count) {
+		_cconf_spans_rebuild(cconf);
+
+		if (cconf->spans.bytes == NULL || cconf->spans.lines == NULL) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
+		}
+	}
+
+	if (cached) {
+		data = cconf->data;
+		len = cconf->len;
+	}
+	else if (copy || append) {
+		len = (size_t)cconf->stamp.size;
+	}
+	else if (in_place) {
+		CCONF_STATUS ret;
+		int64_t bytes, lines;
+
+		// Only the part of the file from the first dirty field is needed
+		base = (size_t)cconf->stamp.size;
+
+		if (first < cconf->values.count && cconf->values.items[first]->start >= 0) {
+			_cconf_spans_query(&cconf->spans, first, &bytes, &lines);
+			base = cconf->values.items[first]->start + bytes;
+		}
+
+		for (size_t i = 0; i < inserted.count; i++) {
+			CConfField* anchor = inserted.items[i]->anchor;
+
+			_cconf_spans_query(&cconf->spans, anchor->pos, &bytes, &lines);
+
+			if ((size_t)(anchor->end + bytes) < base) {
+				base = anchor->end + bytes;
+			}
+		}
+
+		if ((ret = _cconf_read_file_from(cconf->filepath, base, &len, &data)) != CCONF_STATUS_OK) {
+			_CCONF_RETURN_DEFER(ret);
+		}
+
+		len += base;
+	}
+	else {
+		CCONF_STATUS ret;
+
+		if ((
+			ret = _cconf_read_entire_file(
+				cconf->filepath,
+				&len, &data
+			)
+			) != CCONF_STATUS_OK) {
+			_CCONF_RETURN_DEFER(ret);
+		}
+
+		if (!valid) {
+			base_lines = _cconf_count_newlines(data, len);
+		}
+	}
+
+	_CConfOutput_init(&out, 256);
+	_CConfSegment_da_init(&segments, 8);
+
+	{
+		size_t last = 0;
+		int64_t change = 0;
+		int64_t line_change = 0;
+		int64_t bytes, lines;
+		size_t i;
+		size_t k = 0;
+
+		for (i = 0; i < cconf->values.count; i++) {
+			CConfField* field = cconf->values.items[i];
+
+			if (field->dirty) {
+				if (field->start < 0) {
+					field->dirty = false;
+					break;
+				}
+
+				_cconf_write_replace(cconf, i, data, base, &segments, &out, &last, &change, &line_change);
+			}
+
+			if (k < inserted.count && inserted.items[k]->anchor->pos == i) {
+				_cconf_spans_query(&cconf->spans, i, &bytes, &lines);
+
+				// New offsets of the end of the anchor
+				int64_t end = field->end + bytes;
+				int64_t endl = field->endl + lines;
+
+				_cconf_segment_add(&segments, true, last, end - change - last);
+				last = end - change;
+
+				for (; k < inserted.count && inserted.items[k]->anchor->pos == i; k++) {
+					size_t old_count = out.count;
+					int64_t new_lines = _cconf_write_field(inserted.items[k], &out);
+					int64_t new_size = out.count - old_count;
+
+					_cconf_segment_add(&segments, false, old_count, new_size);
+
+					placed[k].start = end;
+					placed[k].end = end + new_size;
+					placed[k].startl = endl + 1;
+					placed[k].endl = endl + new_lines;
+					inserted.items[k]->dirty = false;
+					_cconf_write_value_span(inserted.items[k], new_size, new_lines);
+
+					end += new_size;
+					endl += new_lines;
+
+					_cconf_spans_add(&cconf->spans, i, new_size, new_lines);
+					change += new_size;
+					line_change += new_lines;
+				}
+			}
+		}
+
+		_cconf_segment_add(&segments, true, last, len - last);
+		size = len + change;
+
+		int64_t line = line_change + (int64_t)base_lines;
+
+		// Appended fields that were removed before being written, and the
+		// inserted fields that were already written, are skipped
+		size_t appended = i;
+
+		while (
+			appended < cconf->values.count &&
+			(cconf->values.items[appended]->removed || _cconf_is_inserted(cconf->values.items[appended]))
+		) {
+			cconf->values.items[appended++]->dirty = false;
+		}
+
+		if (appended != cconf->values.count) {
+			if (i != 0) {
+				_cconf_output_write(&out, "\n", 1);
+				_cconf_segment_add(&segments, false, out.count - 1, 1);
+				size++;
+				line++;
+			}
+
+			for (; i < cconf->values.count; i++) {
+				CConfField* field = cconf->values.items[i];
+
+				if (field->removed || _cconf_is_inserted(field)) {
+					field->dirty = false;
+					continue;
+				}
+
+				size_t old_count = out.count;
+				int64_t new_lines = _cconf_write_field(field, &out);
+				size_t new_size = out.count - old_count;
+
+				_cconf_segment_add(&segments, false, old_count, new_size);
+
+				// Stored relative to the changes made before the field
+				_cconf_spans_query(&cconf->spans, i, &bytes, &lines);
+
+				field->dirty = false;
+				field->start = size - bytes;
+				field->end = size + new_size - bytes;
+				field->startl = line - lines;
+				field->endl = field->startl + new_lines - 1;
+				_cconf_write_value_span(field, new_size, new_lines);
+
+				size += new_size;
+				line += new_lines;
+			}
+		}
+
+		cconf->lines = line;
+	}
+
+	if (inserted.count > 0 && (status = _cconf_values_reorder(cconf, &inserted, placed)) != CCONF_STATUS_OK) {
+		_CCONF_RETURN_DEFER(status);
+	}
+
+	if (cconf->flags & CCONF_FLAG_KEEP_BUFFER) {
+		char* joined = _cconf_segments_join(&segments, data, &out, size);
+
+		if (joined == NULL) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
+		}
+
+		if (append) {
+			status = _cconf_append_file(cconf->filepath, out.items, out.count);
+		}
+		else
+#ifdef _CCONF_ATOMIC
+		if (atomic) {
+			_CConfSegment whole = { 0, size, true };
+			_CConfSegment_da replace = { &whole, 1, 1 };
+
+			status = _cconf_replace_segments(cconf->filepath, &replace, joined, &out, false, true);
+		}
+		else
+#endif
+#ifdef _CCONF_IN_PLACE
+		if (in_place) {
+			_CConfSegment whole = { 0, size, true };
+			_CConfSegment_da patch = { &whole, 1, 1 };
+
+			status = _cconf_patch_segments(
+				cconf->filepath,
+				&patch, joined, 0, &out,
+				_cconf_segments_prefix(&segments), size
+			);
+		}
+		else
+#endif
+		{
+			status = _cconf_write_file(cconf->filepath, joined, size);
+		}
+
+		if (status != CCONF_STATUS_OK) {
+			free(joined);
+			_CCONF_RETURN_DEFER(status);
+		}
+
+		_cconf_cache_set(cconf, joined, size);
+
+		// The cached buffer is now owned by the CConfFile
+		if (cached) {
+			cached = false;
+			data = NULL;
+		}
+	}
+	else if (append) {
+		if (out.count > 0) {
+			status = _cconf_append_file(cconf->filepath, out.items, out.count);
+		}
+	}
+#ifdef _CCONF_ATOMIC
+	else if (copy || atomic) {
+		status = _cconf_replace_segments(cconf->filepath, &segments, data, &out, copy, atomic);
+	}
+#endif
+#ifdef _CCONF_IN_PLACE
+	else if (in_place) {
+		status = _cconf_patch_segments(
+			cconf->filepath,
+			&segments, data, base, &out,
+			_cconf_segments_prefix(&segments), size
+		);
+	}
+#endif
+	else {
+		status = _cconf_write_segments(cconf->filepath, &segments, data, &out);
+	}
+
+	if (status == CCONF_STATUS_OK && !_cconf_stamp(cconf->filepath, &cconf->stamp)) {
+		memset(&cconf->stamp, 0, sizeof(_CConfStamp));
+	}
+	else if (status == CCONF_STATUS_OK && (cconf->flags & CCONF_FLAG_REBASE) && cconf->data != NULL) {
+		cconf->stamp.hash = _cconf_hash_content(cconf->data, cconf->len);
+		cconf->stamp.hashed = true;
+	}
+
+	// The removed fields are only freed once they are at least half of them,
+	// so that removing many fields costs a single pass over `values`
+	if (status == CCONF_STATUS_OK && cconf->removed > 0 && cconf->removed * 2 >= cconf->values.count) {
+		_cconf_values_compact(cconf);
+	}
+
+defer:
+	if (!cached) {
+		free(data);
+	}
+
+	free(out.items);
+	free(segments.items);
+	free(inserted.items);
+	free(placed);
+
+	return status;
+}
+
+CCONFDEF CCONF_STATUS cconf_write(CConfFile* cconf) {
+	if (!_cconf_write_supported(cconf)) {
+		return CCONF_STATUS_UNSUPPORTED;
+	}
+
+	if (cconf->commit_interval > 0 || cconf->commit_threshold > 0) {
+		int64_t now = _cconf_now();
+		size_t dirty = 0;
+
+		for (size_t i = 0; i < cconf->values.count; i++) {
+			dirty += cconf->values.items[i]->dirty;
+		}
+
+		if (dirty == 0) {
+			return CCONF_STATUS_OK;
+		}
+
+		if (!cconf->pending) {
+			cconf->pending = true;
+			cconf->pending_since = now;
+		}
+
+		bool due = (cconf->commit_threshold > 0 && dirty >= cconf->commit_threshold) ||
+			(cconf->commit_interval > 0 && now - cconf->pending_since >= cconf->commit_interval);
+
+		if (!due) {
+			return CCONF_STATUS_OK;
+		}
+	}
+
+	return cconf_flush(cconf);
+}
+
+// Appends the dirty fields to the journal instead of the file
+static inline CCONF_STATUS _cconf_journal_write(CConfFile* cconf) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	_CConfOutput out = { 0 };
+	char* path = NULL;
+	size_t threshold = cconf->journal_threshold > 0 ? cconf->journal_threshold : CCONF_JOURNAL_THRESHOLD;
+
+	bool removed = false;
+
+	_CConfOutput_init(&out, 256);
+
+	// Removals cannot be journaled, and are written to the file right away
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->dirty && field->removed) {
+			removed = true;
+		}
+		else if (field->dirty) {
+			_cconf_write_field(field, &out);
+		}
+	}
+
+	if (out.count > 0) {
+		if ((path = _cconf_journal_path(cconf->filepath)) == NULL) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
+		}
+
+		if ((status = _cconf_append_file(path, out.items, out.count)) != CCONF_STATUS_OK) {
+			_CCONF_RETURN_DEFER(status);
+		}
+
+		for (size_t i = 0; i < cconf->values.count; i++) {
+			CConfField* field = cconf->values.items[i];
+
+			if (field->dirty && !field->removed) {
+				field->dirty = false;
+				field->journaled = true;
+			}
+		}
+
+		cconf->journal_size = cconf->journal_size > SIZE_MAX - out.count ?
+			SIZE_MAX : cconf->journal_size + out.count;
+	}
+
+	if (removed || cconf->journal_size >= threshold) {
+		status = cconf_journal_compact(cconf);
+	}
+
+defer:
+	free(out.items);
+	free(path);
+
+	return status;
+}
+
+// --------------------------------------------------
+// Rebase related functions
+
+// Location of a field inside the current contents of a file
+typedef struct {
+	const char* name;
+	size_t len;
+	CConfSpan span;
+	CConfSpan value;
+	bool taken;
+} _CConfKey;
+
+_CCONF_CREATE_DA(_CConfKey, _CConfKey_da)
+
+// Finds the location of the next field, walking the same grammar as
+// _cconf_validate_field without decoding any value
+static inline uint8_t _cconf_index_field(_CConfLexer* lexer, _CConfKey* key) {
+	_CConfToken token;
+	_CConfToken value;
+
+	if (!_cconf_validate_expect(lexer, _CCONF_LEXER_LITERAL | _CCONF_LEXER_EOF, &token)) {
+		return _CCONF_PARSE_SYNTAX;
+	}
+
+	if (token.type == _CCONF_LEXER_EOF) {
+		return _CCONF_PARSE_EOF;
+	}
+
+	key->name = token.data;
+	key->len = token.len;
+	key->span.start = (token.data - lexer->data) - token.col;
+	key->span.startl = token.row;
+
+	if (
+		!_cconf_validate_expect(lexer, _CCONF_LEXER_EQUALS, &token) ||
+		!_cconf_validate_expect(
+			lexer,
+			_CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER | _CCONF_LEXER_DECIMAL |
+			_CCONF_LEXER_BOOLEAN | _CCONF_LEXER_OSQUARE,
+			&value
+		)
+	) {
+		return _CCONF_PARSE_SYNTAX;
+	}
+
+	key->value.start = _cconf_token_start(lexer, &value) - key->span.start;
+	key->value.startl = value.row - key->span.startl;
+
+	if (value.type == _CCONF_LEXER_OSQUARE) {
+		uint16_t exp_token = _CCONF_LEXER_STRING | _CCONF_LEXER_NUMBER |
+			_CCONF_LEXER_DECIMAL | _CCONF_LEXER_BOOLEAN;
+
+		while (true) {
+			if (!_cconf_validate_expect(lexer, exp_token, &value)) {
+				return _CCONF_PARSE_SYNTAX;
+			}
+
+			exp_token = value.type;
+
+			if (!_cconf_validate_expect(lexer, _CCONF_LEXER_COMMA | _CCONF_LEXER_CSQUARE, &value)) {
+				return _CCONF_PARSE_SYNTAX;
+			}
+
+			if (value.type == _CCONF_LEXER_CSQUARE) {
+				break;
+			}
+		}
+	}
+
+	key->value.end = _cconf_token_end(lexer, &value) - key->span.start;
+	key->span.endl = value.last_row;
+	key->value.endl = key->span.endl - key->span.startl;
+
+	if (!_cconf_parser_expect_tokens(lexer, _CCONF_LEXER_NEWLINE | _CCONF_LEXER_EOF, &token)) {
+		return _CCONF_PARSE_SYNTAX;
+	}
+
+	key->span.end = token.type == _CCONF_LEXER_EOF ? lexer->len : lexer->pos;
+	return _CCONF_PARSE_FIELD;
+}
+
+// Matches the first key with the name that was not taken yet
+static inline bool _cconf_rebase_equal(const void* key, size_t index, const void* user) {
+	const _CConfName* name = (const _CConfName*)key;
+	const _CConfKey* other = &((const _CConfKey_da*)user)->items[index];
+
+	return !other->taken && other->len == name->len && memcmp(other->name, name->data, name->len) == 0;
+}
+
+static inline int _cconf_rebase_compare(const void* a, const void* b) {
+	const CConfField* x = *(CConfField* const*)a;
+	const CConfField* y = *(CConfField* const*)b;
+
+	// Fields that are not inside the file go last, in their current order
+	if ((x->start < 0) != (y->start < 0)) {
+		return x->start < 0 ? 1 : -1;
+	}
+
+	if (x->start >= 0 && x->start != y->start) {
+		return x->start < y->start ? -1 : 1;
+	}
+
+	return x->pos < y->pos ? -1 : (x->pos > y->pos);
+}
+
+// Moves every field to its location inside `data`, the current contents
+// of the file, by matching their names. The values that were not changed
+// are left as they are in memory, and anything that only exists inside
+// `data` is kept as is by the next write. Dirty fields that are not inside
+// `data` anymore are appended again, while the other ones are removed.
+static inline CCONF_STATUS _cconf_rebase(CConfFile* cconf, char* data, size_t len) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	_CConfLexer lexer = { 0 };
+	_CConfKey_da keys = { 0 };
+	_CConfKey key;
+	_CConfHashTable table = { 0 };
+	uint8_t res;
+
+	lexer.data = data;
+	lexer.len = len;
+	_CConfKey_da_init(&keys, 64);
+
+	while ((res = _cconf_index_field(&lexer, &key)) == _CCONF_PARSE_FIELD) {
+		key.taken = false;
+		_CConfKey_da_append(&keys, key);
+	}
+
+	if (res != _CCONF_PARSE_EOF) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_PARSE);
+	}
+
+	if (!_cconf_hashtable_reset(&table, keys.count)) {
+		_CCONF_RETURN_DEFER(CCONF_STATUS_MALLOC);
+	}
+
+	// Keys with the same name are found in the order of the file
+	for (size_t i = 0; i < keys.count; i++) {
+		_cconf_hashtable_add(&table, _cconf_hash(keys.items[i].name, keys.items[i].len), i);
+	}
+
+	_cconf_spans_flatten(cconf);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+		_CConfName name = { field->fieldname, CCONF_STRING_SIZE(field->fieldname) };
+		int64_t found;
+
+		if (field->start < 0) {
+			continue;
+		}
+
+		// Removals that were already written do not match anything
+		if (field->removed && !field->dirty) {
+			_cconf_field_unplace(field);
+			continue;
+		}
+
+		found = _cconf_hashtable_get(&table, _cconf_hash(name.data, name.len), &name, _cconf_rebase_equal, &keys);
+
+		if (found >= 0) {
+			_CConfKey* match = &keys.items[found];
+
+			match->taken = true;
+			field->start = match->span.start;
+			field->end = match->span.end;
+			field->startl = match->span.startl;
+			field->endl = match->span.endl;
+			field->value = match->value;
+			continue;
+		}
+
+		_cconf_field_unplace(field);
+
+		if (field->dirty && !field->removed) {
+			continue;
+		}
+
+		if (!field->removed) {
+			field->removed = true;
+			cconf->removed++;
+		}
+
+		field->dirty = false;
+	}
+
+	// Insertions after a field that is gone are appended instead
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->anchor != NULL && field->anchor->start < 0) {
+			field->anchor = NULL;
+		}
+	}
+
+	qsort(cconf->values.items, cconf->values.count, sizeof(CConfField*), _cconf_rebase_compare);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		cconf->values.items[i]->pos = i;
+	}
+
+	cconf->lines = _cconf_count_newlines(data, len);
+
+defer:
+	_CConfKey_da_free(&keys);
+	_cconf_hashtable_free(&table);
+	return status;
+}
+
+// Returns whether the file still holds the contents seen by the last load
+// or write. If it does not, its current contents are stored in `data`.
+static inline CCONF_STATUS _cconf_rebase_check(CConfFile* cconf, bool* valid, char** data, size_t* len) {
+	CCONF_STATUS status;
+
+	*valid = false;
+	*data = NULL;
+
+	if (!_cconf_stamp_valid(cconf)) {
+		return _cconf_read_entire_file(cconf->filepath, len, data);
+	}
+
+	// A change within the same second would not move `mtime`
+	if (cconf->stamp.mtime < cconf->stamp.taken) {
+		*valid = true;
+		return CCONF_STATUS_OK;
+	}
+
+	if ((status = _cconf_read_entire_file(cconf->filepath, len, data)) != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	if (cconf->stamp.hashed && cconf->stamp.hash == _cconf_hash_content(*data, *len)) {
+		*valid = true;
+		free(*data);
+		*data = NULL;
+	}
+
+	return CCONF_STATUS_OK;
+}
+
+// Writes the changes over the current contents of the file, even if
+// another process changed it since the last load or write. The file is
+// only locked while it is checked and written.
+static inline CCONF_STATUS _cconf_write_rebase(CConfFile* cconf) {
+	CCONF_STATUS status = CCONF_STATUS_OK;
+	char* data = NULL;
+	size_t len;
+	bool valid;
+
+#ifdef _CCONF_LOCK
+	int fd;
+
+	// The lock is taken on the file that is currently at the path, since
+	// atomic writes replace it while others might be waiting for the lock
+	while (true) {
+		struct stat locked, current;
+
+		if ((fd = open(cconf->filepath, O_RDONLY)) < 0) {
+			return CCONF_STATUS_FOPEN;
+		}
+
+		if (flock(fd, LOCK_EX) != 0) {
+			close(fd);
+			return CCONF_STATUS_FOPEN;
+		}
+
+		if (
+			fstat(fd, &locked) == 0 && stat(cconf->filepath, &current) == 0 &&
+			locked.st_dev == current.st_dev && locked.st_ino == current.st_ino
+		) {
+			break;
+		}
+
+		close(fd);
+	}
+#endif
+
+	if ((status = _cconf_rebase_check(cconf, &valid, &data, &len)) != CCONF_STATUS_OK) {
+		_CCONF_RETURN_DEFER(status);
+	}
+
+	if (!valid) {
+		if ((status = _cconf_rebase(cconf, data, len)) != CCONF_STATUS_OK) {
+			_CCONF_RETURN_DEFER(status);
+		}
+
+		// The contents that were just read are the base of the write
+		if (!_cconf_stamp(cconf->filepath, &cconf->stamp)) {
+			_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
+		}
+
+		if (cconf->flags & CCONF_FLAG_KEEP_BUFFER) {
+			_cconf_cache_set(cconf, data, len);
+			data = NULL;
+		}
+	}
+
+	status = _cconf_write(cconf);
+
+defer:
+	free(data);
+
+#ifdef _CCONF_LOCK
+	flock(fd, LOCK_UN);
+	close(fd);
+#endif
+
+	return status;
+}
+
+CCONFDEF CCONF_STATUS cconf_flush(CConfFile* cconf) {
+	cconf->pending = false;
+	_cconf_retired_sweep(cconf, false);
+
+	if (cconf->flags & CCONF_FLAG_JOURNAL) {
+		return _cconf_journal_write(cconf);
+	}
+
+	if (cconf->flags & CCONF_FLAG_REBASE) {
+		return _cconf_write_rebase(cconf);
+	}
+
+	return _cconf_write(cconf);
+}
+
+CCONFDEF CCONF_STATUS cconf_journal_compact(CConfFile* cconf) {
+	CCONF_STATUS status;
+	char* path;
+
+	// The records of the fields that were not loaded would be lost
+	if (cconf->journal_partial) {
+		return CCONF_STATUS_OK;
+	}
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+
+		if (field->journaled) {
+			field->dirty = true;
+			field->journaled = false;
+		}
+	}
+
+	if ((status = _cconf_write(cconf)) != CCONF_STATUS_OK) {
+		// Writing a field again is harmless, losing it is not
+		for (size_t i = 0; i < cconf->values.count; i++) {
+			cconf->values.items[i]->journaled = true;
+		}
+
+		return status;
+	}
+
+	if ((path = _cconf_journal_path(cconf->filepath)) == NULL) {
+		return CCONF_STATUS_MALLOC;
+	}
+
+	// Replaying a journal that was already compacted is harmless
+	remove(path);
+	free(path);
+	cconf->journal_size = 0;
+
+	return CCONF_STATUS_OK;
+}
+
+// Schema functions
+
+CCONFDEF CCONF_STATUS cconf_schema_compile(
+	CConfSchema* schema,
+	const CConfSchemaRule* rules,
+	size_t count,
+	bool strict
+) {
+	_Static_assert(CCONF_TYPE_AMOUNT == 8, "Incorrect type amount");
+	size_t enums_count = 0;
+
+	memset(schema, 0, sizeof(CConfSchema));
+	schema->strict = strict;
+
+	for (size_t i = 0; i < count; i++) {
+		if (rules[i].flags & CCONF_SCHEMA_ENUM) {
+			enums_count += rules[i].values_count;
+		}
+	}
+
+	schema->entries = (_CConfSchemaEntry*)calloc(count == 0 ? 1 : count, sizeof(_CConfSchemaEntry));
+	schema->enums = (CConfString**)calloc(enums_count == 0 ? 1 : enums_count, sizeof(CConfString*));
+
+	if (
+		!_cconf_hashtable_reset(&schema->table, count) ||
+		schema->entries == NULL || schema->enums == NULL
+	) {
+		cconf_schema_free(schema);
+		return CCONF_STATUS_MALLOC;
+	}
+
+	enums_count = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		const CConfSchemaRule* rule = &rules[i];
+		_CConfSchemaEntry* entry = &schema->entries[i];
+		size_t len = strlen(rule->fieldname);
+
+		// A later rule for the same field could never be found
+		if (_cconf_schema_find(schema, rule->fieldname, len) != NULL) {
+			cconf_schema_free(schema);
+			return CCONF_STATUS_SCHEMA;
+		}
+
+		entry->fieldname = cconf_string_from_sized_string(rule->fieldname, len);
+		entry->type = rule->type;
+		entry->flags = rule->flags;
+		entry->min_count = rule->min_count;
+		entry->max_count = rule->max_count;
+		schema->count++;
+
+		switch (rule->type) {
+		case CCONF_TYPE_NUMBER:
+		case CCONF_TYPE_NUMBER_ARR:
+			entry->lo.num = rule->min_num;
+			entry->hi.num = rule->max_num;
+			break;
+
+		case CCONF_TYPE_DECIMAL:
+		case CCONF_TYPE_DECIMAL_ARR:
+			entry->lo.dec = rule->min_dec;
+			entry->hi.dec = rule->max_dec;
+			break;
+
+		case CCONF_TYPE_STRING:
+		case CCONF_TYPE_STRING_ARR:
+			entry->lo.num = (int64_t)rule->min_len;
+			entry->hi.num = (int64_t)rule->max_len;
+			break;
+		}
+
+		if (rule->flags & CCONF_SCHEMA_REQUIRED) {
+			schema->required++;
+		}
+
+		if (rule->flags & CCONF_SCHEMA_ENUM) {
+			entry->enum_start = enums_count;
+			entry->enum_count = rule->values_count;
+
+			for (size_t j = 0; j < rule->values_count; j++) {
+				schema->enums[enums_count++] = cconf_string_new(rule->values[j]);
+			}
+		}
+
+		_cconf_hashtable_add(&schema->table, _cconf_hash(rule->fieldname, len), i);
+	}
+
+	return CCONF_STATUS_OK;
+}
+
+CCONFDEF void cconf_schema_free(CConfSchema* schema) {
+	if (schema->enums != NULL) {
+		for (size_t i = 0; i < schema->count; i++) {
+			_CConfSchemaEntry* entry = &schema->entries[i];
+
+			for (size_t j = entry->enum_start; j < entry->enum_start + entry->enum_count; j++) {
+				cconf_string_free(schema->enums[j]);
+			}
+		}
+	}
+
+	if (schema->entries != NULL) {
+		for (size_t i = 0; i < schema->count; i++) {
+			cconf_string_free(schema->entries[i].fieldname);
+		}
+	}
+
+	free(schema->entries);
+	_cconf_hashtable_free(&schema->table);
+	free(schema->enums);
+	memset(schema, 0, sizeof(CConfSchema));
+}
+
+// Reader functions
+
+CCONFDEF CCONF_STATUS cconf_reader_open(CConfReader* reader, const char* filepath) {
+	_CConfLexer lexer;
+	CCONF_STATUS status = _cconf_read_entire_file(filepath, &lexer.len, &lexer.data);
+
+	if (status != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	cconf_reader_open_buffer(reader, lexer.data, lexer.len);
+	reader->data = lexer.data;
+	return CCONF_STATUS_OK;
+}
+
+CCONFDEF void cconf_reader_open_buffer(CConfReader* reader, const char* data, size_t len) {
+	memset(reader, 0, sizeof(CConfReader));
+
+	// The lexer never writes to the data
+	reader->parser.lexer.data = (char*)data;
+	reader->parser.lexer.len = len;
+}
+
+CCONFDEF CCONF_STATUS cconf_reader_next(CConfReader* reader, CConfField* field) {
+	_CConfParser* parser = &reader->parser;
+
+	if (!reader->started) {
+		_CConfLexer lexer = parser->lexer;
+		CCONF_STATUS status = _cconf_parser_init(
+			parser, &lexer,
+			reader->flags, reader->element_handler, reader->user,
+			reader->schema, &reader->violation
+		);
+
+		if (status != CCONF_STATUS_OK) {
+			return status;
+		}
+
+		reader->started = true;
+	}
+
+	switch (_cconf_parse_field(parser, field)) {
+	case _CCONF_PARSE_FIELD:
+		return CCONF_STATUS_OK;
+
+	case _CCONF_PARSE_EOF:
+		return CCONF_STATUS_EOF;
+
+	case _CCONF_PARSE_SYNTAX:
+		return CCONF_STATUS_PARSE;
+
+	case _CCONF_PARSE_SCHEMA:
+		return CCONF_STATUS_SCHEMA;
+
+	default:
+		assert(0 && "Unreachable");
+	}
+
+	return CCONF_STATUS_PARSE;
+}
+
+CCONFDEF void cconf_reader_format_error(CConfReader* reader, char* buf) {
+	_cconf_parser_format_error(reader->parser.expected, &reader->parser.got, buf);
+}
+
+CCONFDEF void cconf_reader_close(CConfReader* reader) {
+	_cconf_parser_free(&reader->parser);
+	free(reader->data);
+	reader->data = NULL;
+}
+
+// Validation functions
+
+CCONFDEF CCONF_STATUS cconf_validate(const char* filepath, CConfDiagnostics* diagnostics) {
+	_CConfLexer lexer;
+	CCONF_STATUS status = _cconf_read_entire_file(filepath, &lexer.len, &lexer.data);
+
+	if (status != CCONF_STATUS_OK) {
+		return status;
+	}
+
+	status = cconf_validate_buffer(lexer.data, lexer.len, diagnostics);
+	free(lexer.data);
+	return status;
+}
+
+CCONFDEF CCONF_STATUS cconf_validate_buffer(const char* data, size_t len, CConfDiagnostics* diagnostics) {
+	_CConfLexer lexer = { 0 };
+
+	// The lexer never writes to the data
+	lexer.data = (char*)data;
+	lexer.len = len;
+
+	return _cconf_validate(&lexer, diagnostics);
+}
+
+CCONFDEF void cconf_diagnostic_format(const CConfDiagnostic* diagnostic, char* buf) {
+	_CConfToken got = { 0 };
+	got.row = diagnostic->row;
+	got.col = diagnostic->col;
+	got.type = diagnostic->got;
+
+	_cconf_parser_format_error(diagnostic->expected, &got, buf);
+}
+
+// Array functions
+
+CCONFDEF CCONF_STATUS cconf_array_index(CConfField* field) {
+	assert(
+		(field->type == CCONF_TYPE_STRING_ARR || field->type == CCONF_TYPE_NUMBER_ARR) &&
+		"Only string and number arrays can be indexed"
+	);
+
+	_CConfArrayIndex* index = field->index;
+
+	if (index == NULL) {
+		index = (_CConfArrayIndex*)calloc(1, sizeof(_CConfArrayIndex));
+
+		if (index == NULL) {
+			return CCONF_STATUS_MALLOC;
+		}
+	}
+
+	field->index = index;
+
+	if (!_cconf_hashtable_reset(&index->table, field->arr.count)) {
+		cconf_array_index_free(field);
+		return CCONF_STATUS_MALLOC;
+	}
+
+	for (size_t i = 0; i < field->arr.count; i++) {
+		_cconf_hashtable_add(&index->table, _cconf_array_hash(field->type, field->arr.items[i]), i);
+	}
+
+	index->items = field->arr.items;
+	index->count = field->arr.count;
+	return CCONF_STATUS_OK;
+}
+
+CCONFDEF void cconf_array_index_free(CConfField* field) {
+	if (field->index == NULL) {
+		return;
+	}
+
+	_cconf_hashtable_free(&field->index->table);
+	free(field->index);
+	field->index = NULL;
+}
 
-		pCConfField_da_append(&cconf->values, field);
-		handler(field, user);
+CCONFDEF bool cconf_array_contains_string(CConfField* field, const char* s, size_t len) {
+	assert(field->type == CCONF_TYPE_STRING_ARR && "Field is not a string array");
 
-		present = _cconf_parser_expect_tokens(
-			lexer,
-			_CCONF_LEXER_NEWLINE | _CCONF_LEXER_EOF,
-			&name_token
-		);
+	if (_cconf_array_index_stale(field) && cconf_array_index(field) != CCONF_STATUS_OK) {
+		for (size_t i = 0; i < field->arr.count; i++) {
+			CConfString* item = field->arr.items[i].str;
 
-		if (!present) {
-			_cconf_parser_expect_error(_CCONF_LEXER_NEWLINE | _CCONF_LEXER_EOF, &name_token);
-			return false;
+			if (CCONF_STRING_SIZE(item) == len && memcmp(item, s, len) == 0) {
+				return true;
+			}
 		}
 
-		if (name_token.type == _CCONF_LEXER_EOF) {
-			break;
-		}
+		return false;
 	}
 
-	return true;
+	_CConfName key = { s, len };
+	return _cconf_hashtable_get(&field->index->table, _cconf_hash(s, len), &key, _cconf_array_equal_string, field) >= 0;
 }
 
-// --------------------------------------------------
-// Writing related functions
+CCONFDEF bool cconf_array_contains_number(CConfField* field, int64_t num) {
+	assert(field->type == CCONF_TYPE_NUMBER_ARR && "Field is not a number array");
 
-static inline void _cconf_write_find_newlines(_CConf_size_t_da* arr, char* data, size_t datalen) {
-	char* start = data;
-	char* curr = data;
+	if (_cconf_array_index_stale(field) && cconf_array_index(field) != CCONF_STATUS_OK) {
+		for (size_t i = 0; i < field->arr.count; i++) {
+			if (field->arr.items[i].num == num) {
+				return true;
+			}
+		}
 
-	while ((data = (char*)memchr(data, '\n', datalen))) {
-		datalen -= (data - curr) + 1;
-		_CConf_size_t_da_append(arr, data - start);
-		data++;
-		curr = data;
+		return false;
 	}
+
+	return _cconf_hashtable_get(&field->index->table, _cconf_hash_number(num), &num, _cconf_array_equal_number, field) >= 0;
 }
 
-static inline void _cconf_write_copy(size_t fline, size_t lline, _CConf_size_t_da newlines, char* data, FILE* f) {
-	assert(fline <= lline);
-	size_t start;
+#ifdef CCONF_HAS_ATOMICS
+// Live field functions
 
-	if (fline == 0) {
-		start = 0;
-	}
-	else {
-		start = newlines.items[fline - 1] + 1;
-	}
+// The scalar getters and setters can be used by different threads at the
+// same time, as long as only one thread updates the file
+CCONFDEF int64_t cconf_field_number(const CConfField* field) {
+	assert(field->type == CCONF_TYPE_NUMBER && "Field is not a number");
 
-	fprintf(f, "%.*s", (int)(newlines.items[lline] - start) + 1, &data[start]);
+	CConfAs as;
+	_CCONF_LOAD_VALUE(&field->as, &as);
+	return as.num;
 }
 
-static inline size_t _cconf_write_string(CConfAs t, FILE* f) {
-	size_t res = 1;
-	fputc('"', f);
+CCONFDEF double cconf_field_decimal(const CConfField* field) {
+	assert(field->type == CCONF_TYPE_DECIMAL && "Field is not a decimal");
 
-	for (CConfStringSize i = 0; i < CCONF_STRING_SIZE(t.str); i++) {
-		if (t.str[i] == '\n') {
-			res++;
-		}
-		else if (t.str[i] == '"') {
-			fputc('\\', f);
-		}
-		else if (t.str[i] == '\\') {
-			fputc('\\', f);
-		}
+	CConfAs as;
+	_CCONF_LOAD_VALUE(&field->as, &as);
+	return as.dec;
+}
 
-		fputc(t.str[i], f);
-	}
+CCONFDEF bool cconf_field_boolean(const CConfField* field) {
+	assert(field->type == CCONF_TYPE_BOOLEAN && "Field is not a boolean");
 
-	fputc('"', f);
-	return res;
+	CConfAs as;
+	_CCONF_LOAD_VALUE(&field->as, &as);
+	return as.boolean;
 }
 
-static inline size_t _cconf_write_number(CConfAs t, FILE* f) {
-	fprintf(f, "%" PRId64, t.num);
-	return 1;
+// Copies at most `size` bytes of the value into `buf`, which is not NULL
+// terminated, and returns the length of the value
+CCONFDEF size_t cconf_field_string(CConfField* field, char* buf, size_t size) {
+	assert(field->type == CCONF_TYPE_STRING && "Field is not a string");
+
+	// The updater does not free the string while it is counted here
+	_CCONF_INCREMENT(&field->readers);
+
+	CConfString* str = (CConfString*)(uintptr_t)_CCONF_LOAD(&field->as.str);
+	size_t len = CCONF_STRING_SIZE(str);
+	memcpy(buf, str, len < size ? len : size);
+
+	_CCONF_DECREMENT(&field->readers);
+	return len;
 }
 
-static inline size_t _cconf_write_decimal(CConfAs t, FILE* f) {
-	fprintf(f, "%.1lf", t.dec);
-	return 1;
+// Changes after every update of the value, so that readers can keep
+// the value they derived from it until it changes
+CCONFDEF uint32_t cconf_field_generation(const CConfField* field) {
+	return _CCONF_LOAD_ACQUIRE(&field->generation);
 }
 
-static inline size_t _cconf_write_boolean(CConfAs t, FILE* f) {
-	if (t.boolean) {
-		fputs("true", f);
-	}
-	else {
-		fputs("false", f);
-	}
+static inline void _cconf_field_update(CConfField* field, CConfAs as) {
+	_CCONF_STORE_VALUE(&field->as, &as);
+	_CCONF_STORE_RELEASE(&field->dirty, true);
+	_CCONF_INCREMENT(&field->generation);
+}
 
-	return 1;
+CCONFDEF void cconf_field_set_number(CConfField* field, int64_t num) {
+	assert(field->type == CCONF_TYPE_NUMBER && "Field is not a number");
+
+	CConfAs as = { 0 };
+	as.num = num;
+	_cconf_field_update(field, as);
 }
 
-static inline size_t _cconf_write_array(CConfAs_da arr, FILE* f, size_t(*writer)(CConfAs, FILE*)) {
-	size_t res = 1;
+CCONFDEF void cconf_field_set_decimal(CConfField* field, double dec) {
+	assert(field->type == CCONF_TYPE_DECIMAL && "Field is not a decimal");
 
-	fputc('[', f);
+	CConfAs as = { 0 };
+	as.dec = dec;
+	_cconf_field_update(field, as);
+}
 
-	for (size_t i = 0; i < arr.count; i++) {
-		res += writer(arr.items[i], f) - 1;
+CCONFDEF void cconf_field_set_boolean(CConfField* field, bool boolean) {
+	assert(field->type == CCONF_TYPE_BOOLEAN && "Field is not a boolean");
 
-		if (i != arr.count - 1) {
-			fputc(',', f);
-		}
+	CConfAs as = { 0 };
+	as.boolean = boolean;
+	_cconf_field_update(field, as);
+}
+
+// The old string is freed right away when no thread is copying it,
+// otherwise by a later update or write once it is no longer read
+CCONFDEF void cconf_field_set_string(CConfFile* cconf, CConfField* field, const char* s, size_t len) {
+	assert(field->type == CCONF_TYPE_STRING && "Field is not a string");
+
+	CConfString* str = cconf_string_from_sized_string(s, (CConfStringSize)len);
+	CConfString* old = (CConfString*)(uintptr_t)_CCONF_EXCHANGE(&field->as.str, str);
+	_CCONF_STORE_RELEASE(&field->dirty, true);
+	_CCONF_INCREMENT(&field->generation);
+
+	_cconf_retired_sweep(cconf, false);
+
+	if (_CCONF_LOAD(&field->readers) == 0) {
+		cconf_string_free(old);
+		return;
 	}
 
-	fputc(']', f);
-	return res;
+	if (cconf->retired.capacity == 0) {
+		_CConfRetired_da_init(&cconf->retired, 4);
+	}
+
+	_CConfRetired retired = { field, old };
+	_CConfRetired_da_append(&cconf->retired, retired);
 }
 
-static inline size_t _cconf_write_field(CConfField* field, FILE* f) {
-	_Static_assert(CCONF_TYPE_AMOUNT == 8, "Incorrect type amount");
+// Snapshot functions
 
-	size_t ret;
-	fprintf(f, "%s=", field->fieldname);
+CCONFDEF void cconf_snapshots_init(CConfSnapshots* snapshots) {
+	memset(snapshots, 0, sizeof(CConfSnapshots));
+	snapshots->epoch = 1;
+}
 
-	switch (field->type) {
-	case CCONF_TYPE_STRING:
-		ret = _cconf_write_string(field->as, f);
-		break;
-	case CCONF_TYPE_NUMBER:
-		ret = _cconf_write_number(field->as, f);
-		break;
-	case CCONF_TYPE_DECIMAL:
-		ret = _cconf_write_decimal(field->as, f);
-		break;
-	case CCONF_TYPE_BOOLEAN:
-		ret = _cconf_write_boolean(field->as, f);
-		break;
-	case CCONF_TYPE_STRING_ARR:
-		ret = _cconf_write_array(field->arr, f, _cconf_write_string);
-		break;
-	case CCONF_TYPE_NUMBER_ARR:
-		ret = _cconf_write_array(field->arr, f, _cconf_write_number);
-		break;
-	case CCONF_TYPE_DECIMAL_ARR:
-		ret = _cconf_write_array(field->arr, f, _cconf_write_decimal);
-		break;
-	case CCONF_TYPE_BOOLEAN_ARR:
-		ret = _cconf_write_array(field->arr, f, _cconf_write_boolean);
-		break;
-	default:
-		assert(0 && "Unreachable");
+// No reader can be using any snapshot
+CCONFDEF void cconf_snapshots_free(CConfSnapshots* snapshots) {
+	_CConfSnapshot* snapshot = snapshots->retired;
+
+	while (snapshot != NULL) {
+		_CConfSnapshot* next = snapshot->next;
+
+		cconf_free(&snapshot->file);
+		free(snapshot);
+		snapshot = next;
 	}
 
-	fputc('\n', f);
-	return ret;
+	if (snapshots->current != NULL) {
+		cconf_free(&snapshots->current->file);
+		free(snapshots->current);
+	}
+
+	cconf_snapshots_init(snapshots);
 }
 
-//// Exported functions
- 
-// String functions
+// Takes the ownership of `cconf`, which is reset. Only a single thread
+// can publish at a time.
+CCONFDEF CCONF_STATUS cconf_snapshot_publish(CConfSnapshots* snapshots, CConfFile* cconf) {
+	_CConfSnapshot* snapshot = (_CConfSnapshot*)malloc(sizeof(_CConfSnapshot));
 
-CCONFDEF CConfString* cconf_string_from_size(CConfStringSize len) {
-	CConfString* res = (CConfString*)malloc(
-		(sizeof(CConfStringSize)) +
-		len + 1
-	);
+	if (snapshot == NULL) {
+		return CCONF_STATUS_MALLOC;
+	}
 
-	*((CConfStringSize*)res) = len;
-	return (CConfString*)(((CConfStringSize*)res) + 1);
-}
+	snapshot->file = *cconf;
+	snapshot->retired = 0;
+	snapshot->next = NULL;
+	*cconf = cconf_init();
 
-CCONFDEF CConfString* cconf_string_new(const char* s) {
-	size_t len = strlen(s);
-	CConfString* res = cconf_string_from_size(len);
-	size_t i = 0;
+	_CConfSnapshot* old = (_CConfSnapshot*)(uintptr_t)_CCONF_EXCHANGE(&snapshots->current, snapshot);
 
-	do {
-		res[i++] = *s;
-	} while (*(s++));
+	if (old != NULL) {
+		// Readers that announce this epoch or a later one can only
+		// see the new snapshot
+		old->retired = _CCONF_INCREMENT(&snapshots->epoch);
+		old->next = snapshots->retired;
+		snapshots->retired = old;
+	}
 
-	return res;
+	cconf_snapshot_reclaim(snapshots);
+	return CCONF_STATUS_OK;
 }
 
-CCONFDEF CConfString* cconf_string_from_sized_string(const char* s, CConfStringSize len) {
-	CConfString* res = cconf_string_from_size(len);
-	memcpy(res, s, len);
-	res[CCONF_STRING_SIZE(res)] = 0;
-	return res;
+// The returned snapshot stays valid until the reader calls
+// cconf_snapshot_quiescent() or cconf_snapshot_offline()
+CCONFDEF const CConfFile* cconf_snapshot_get(CConfSnapshots* snapshots) {
+	_CConfSnapshot* snapshot = (_CConfSnapshot*)(uintptr_t)_CCONF_LOAD_ACQUIRE(&snapshots->current);
+
+	return snapshot != NULL ? &snapshot->file : NULL;
 }
 
-CCONFDEF void cconf_string_free(CConfString* s) {
-	free(((CConfStringSize*)s) - 1);
+// Returns SIZE_MAX when all the CCONF_SNAPSHOT_READERS are taken
+CCONFDEF size_t cconf_snapshot_register(CConfSnapshots* snapshots) {
+	for (size_t i = 0; i < CCONF_SNAPSHOT_READERS; i++) {
+		if (_CCONF_CLAIM(&snapshots->readers[i].used)) {
+			cconf_snapshot_quiescent(snapshots, i);
+			return i;
+		}
+	}
+
+	return SIZE_MAX;
 }
 
-// CConf main functions
+CCONFDEF void cconf_snapshot_unregister(CConfSnapshots* snapshots, size_t reader) {
+	cconf_snapshot_offline(snapshots, reader);
+	_CCONF_RELEASE(&snapshots->readers[reader].used);
+}
 
-CCONFDEF CConfFile cconf_init(void) {
-	CConfFile cconf = { 0 };
-	return cconf;
+// The reader does not hold any snapshot obtained before the call
+CCONFDEF void cconf_snapshot_quiescent(CConfSnapshots* snapshots, size_t reader) {
+	_CCONF_STORE_RELEASE(&snapshots->readers[reader].epoch, _CCONF_LOAD_ACQUIRE(&snapshots->epoch));
+
+	// The epoch must be visible to cconf_snapshot_reclaim() before the
+	// reader loads `current` again, which a release store alone does not
+	// order. Pairs with the fence of cconf_snapshot_reclaim().
+	_CCONF_FENCE();
 }
 
-CCONFDEF void cconf_free(CConfFile* cconf) {
-	_Static_assert(CCONF_TYPE_AMOUNT == 8, "Incorrect type amount");
-	free(cconf->filepath);
+// Same as cconf_snapshot_quiescent(), and the reader is ignored until it
+// calls it again, such as while it is blocked
+CCONFDEF void cconf_snapshot_offline(CConfSnapshots* snapshots, size_t reader) {
+	_CCONF_STORE_RELEASE(&snapshots->readers[reader].epoch, (uint64_t)0);
+}
 
-	for (size_t i = 0; i < cconf->values.count; i++) {
-		switch (cconf->values.items[i]->type) {
-		case CCONF_TYPE_STRING:
-			cconf_string_free(cconf->values.items[i]->as.str);
-			break;
+// Frees the replaced snapshots that no reader can be using anymore, and
+// returns how many are left. It is called by cconf_snapshot_publish(), from
+// the same thread.
+CCONFDEF size_t cconf_snapshot_reclaim(CConfSnapshots* snapshots) {
+	uint64_t oldest = UINT64_MAX;
+	_CConfSnapshot** link = &snapshots->retired;
+	size_t left = 0;
 
-		case CCONF_TYPE_STRING_ARR:
-			for (size_t j = 0; j < cconf->values.items[i]->arr.count; j++) {
-				cconf_string_free(cconf->values.items[i]->arr.items[j].str);
-			}
+	// Either the epochs of the readers are seen, or the readers see the
+	// snapshot that replaced the retired ones
+	_CCONF_FENCE();
 
-			// Fall through
-		case CCONF_TYPE_NUMBER_ARR:
-		case CCONF_TYPE_DECIMAL_ARR:
-		case CCONF_TYPE_BOOLEAN_ARR:
-			CConfAs_da_free(&cconf->values.items[i]->arr);
-			break;
+	for (size_t i = 0; i < CCONF_SNAPSHOT_READERS; i++) {
+		uint64_t epoch = _CCONF_LOAD_ACQUIRE(&snapshots->readers[i].epoch);
+
+		if (epoch != 0 && epoch < oldest) {
+			oldest = epoch;
 		}
+	}
 
-		cconf_string_free(cconf->values.items[i]->fieldname);
-		free(cconf->values.items[i]);
+	while (*link != NULL) {
+		_CConfSnapshot* snapshot = *link;
+
+		if (snapshot->retired <= oldest) {
+			*link = snapshot->next;
+			cconf_free(&snapshot->file);
+			free(snapshot);
+		}
+		else {
+			link = &snapshot->next;
+			left++;
+		}
 	}
 
-	pCConfField_da_free(&cconf->values);
+	return left;
 }
+#endif // CCONF_HAS_ATOMICS
 
-CCONFDEF CCONF_STATUS cconf_load(
-	CConfFile* cconf,
-	const char* filepath,
-	CCONF_HANDLER* handler,
-	void* user
-) {
-	_CConfLexer lexer = { 0 };
+// Watcher functions
 
-	if (cconf->values.items == NULL) {
-		pCConfField_da_init(&cconf->values, 2);
+static inline void _cconf_watcher_field(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+CCONFDEF CCONF_STATUS cconf_watcher_init(CConfWatcher* watcher, CCONF_RELOAD_HANDLER* handler, void* user) {
+	memset(watcher, 0, sizeof(CConfWatcher));
+	watcher->fd = -1;
+	watcher->wake[0] = -1;
+	watcher->wake[1] = -1;
+	watcher->debounce = CCONF_WATCH_DEBOUNCE;
+	watcher->handler = handler;
+	watcher->user = user;
+
+#ifdef _CCONF_WATCH
+	if ((watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		return CCONF_STATUS_WATCH;
 	}
-	else {
-		cconf->values.count = 0;
+
+	if (pipe(watcher->wake) != 0) {
+		close(watcher->fd);
+		watcher->fd = -1;
+		watcher->wake[0] = -1;
+		watcher->wake[1] = -1;
+		return CCONF_STATUS_WATCH;
 	}
 
-	{
-		CCONF_STATUS read_status = _cconf_read_entire_file(filepath, &lexer.len, &lexer.data);
+	fcntl(watcher->wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(watcher->wake[1], F_SETFL, O_NONBLOCK);
 
-		if (read_status != CCONF_STATUS_OK) {
-			return read_status;
-		}
+	_CConfWatch_da_init(&watcher->watches, 2);
+	return CCONF_STATUS_OK;
+#else
+	return CCONF_STATUS_WATCH;
+#endif
+}
+
+// The directory of the file is watched instead of the file itself, since
+// a file replaced with a rename is a different file
+CCONFDEF CCONF_STATUS cconf_watcher_add(CConfWatcher* watcher, const char* filepath) {
+#ifdef _CCONF_WATCH
+	size_t len = strlen(filepath);
+	const char* slash = strrchr(filepath, '/');
+	char* dir = (char*)malloc(len + 2);
+	_CConfWatch watch;
+
+	// The path is allocated first, since a watch on a directory that other
+	// files are in cannot be removed on failure
+	watch.filepath = (char*)malloc(len + 1);
+
+	if (dir == NULL || watch.filepath == NULL) {
+		free(dir);
+		free(watch.filepath);
+		return CCONF_STATUS_MALLOC;
 	}
 
-	cconf->filepath = (char*)malloc((strlen(filepath) + 1) * sizeof(char));
-	strcpy(cconf->filepath, filepath);
+	if (slash == NULL) {
+		strcpy(dir, ".");
+	}
+	else {
+		size_t dir_len = slash == filepath ? 1 : (size_t)(slash - filepath);
+		memcpy(dir, filepath, dir_len);
+		dir[dir_len] = 0;
+	}
 
-	_cconf_parse(cconf, &lexer, handler, user);
+	watch.wd = inotify_add_watch(
+		watcher->fd, dir,
+		IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO
+	);
+	free(dir);
 
-	free(lexer.data);
+	if (watch.wd < 0) {
+		free(watch.filepath);
+		return CCONF_STATUS_WATCH;
+	}
+
+	strcpy(watch.filepath, filepath);
+	watch.name = watch.filepath + (slash == NULL ? 0 : slash - filepath + 1);
+	watch.pending = false;
+	watch.deadline = 0;
 
+	_CConfWatch_da_append(&watcher->watches, watch);
 	return CCONF_STATUS_OK;
+#else
+	(void)watcher;
+	(void)filepath;
+	return CCONF_STATUS_WATCH;
+#endif
 }
 
-CCONFDEF CConfField *cconf_field_new(CConfString *fieldname, uint8_t type) {
-	CConfField *field = (CConfField*)malloc(sizeof(CConfField));
-	field->fieldname = fieldname;
-	field->type = type;
-	return field;
+#ifdef _CCONF_WATCH
+// Every event postpones the reload, so that a burst of writes is reloaded once
+static inline void _cconf_watcher_mark(CConfWatcher* watcher, const struct inotify_event* event, int64_t now) {
+	for (size_t i = 0; i < watcher->watches.count; i++) {
+		_CConfWatch* watch = &watcher->watches.items[i];
+
+		// Events were lost, so every file could have changed
+		if (
+			!(event->mask & IN_Q_OVERFLOW) &&
+			(watch->wd != event->wd || event->len == 0 || strcmp(event->name, watch->name) != 0)
+		) {
+			continue;
+		}
+
+		watch->pending = true;
+		watch->deadline = now + watcher->debounce;
+	}
 }
 
-CCONFDEF void cconf_append_field(CConfFile *cconf, CConfField *field) {
-	field->dirty = true;
-	field->startl = -1;
-	field->endl = -1;
-	pCConfField_da_append(&cconf->values, field);
+static inline void _cconf_watcher_reload(CConfWatcher* watcher, size_t i) {
+	CConfFile cconf = cconf_init();
+	CCONF_HANDLER* handler = watcher->field_handler;
+
+	cconf.flags = watcher->flags | CCONF_FLAG_NO_EXIT;
+	cconf.schema = watcher->schema;
+
+	if (handler == NULL) {
+		handler = _cconf_watcher_field;
+	}
+
+	// The handler can add watches, which moves them
+	char* filepath = watcher->watches.items[i].filepath;
+	CCONF_STATUS status = cconf_load(&cconf, filepath, handler, watcher->user);
+	watcher->handler(&cconf, filepath, status, watcher->user);
 }
+#endif
 
-CCONFDEF CCONF_STATUS cconf_write(CConfFile* cconf) {
-	CCONF_STATUS status = CCONF_STATUS_OK;
-	size_t len;
-	char* data = NULL;
-	FILE* f = NULL;
-	_CConf_size_t_da newlines = { 0 };
+// Reads the pending events without blocking and reloads the files that did
+// not change for `debounce` milliseconds. `timeout` is set to the time in
+// milliseconds before the next reload is due, or -1 if none is.
+CCONFDEF CCONF_STATUS cconf_watcher_process(CConfWatcher* watcher, int* timeout) {
+	*timeout = -1;
 
-	{
-		CCONF_STATUS ret;
+#ifdef _CCONF_WATCH
+	union {
+		struct inotify_event event;
+		char data[4096];
+	} buf;
 
-		if ((
-			ret = _cconf_read_entire_file(
-				cconf->filepath,
-				&len, &data
-			)
-			) != CCONF_STATUS_OK) {
-			_CCONF_RETURN_DEFER(ret);
+	while (true) {
+		ssize_t n = read(watcher->fd, buf.data, sizeof(buf.data));
+
+		if (n < 0 && errno == EINTR) {
+			continue;
 		}
 
-		f = fopen(cconf->filepath, "wb");
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
 
-		if (f == NULL) {
-			_CCONF_RETURN_DEFER(CCONF_STATUS_FOPEN);
+		if (n <= 0) {
+			return CCONF_STATUS_WATCH;
+		}
+
+		int64_t now = _cconf_now();
+		char* p = buf.data;
+
+		while (p < buf.data + n) {
+			const struct inotify_event* event = (const struct inotify_event*)p;
+			_cconf_watcher_mark(watcher, event, now);
+			p += sizeof(struct inotify_event) + event->len;
 		}
 	}
 
-	_CConf_size_t_da_init(&newlines, 2);
-	_cconf_write_find_newlines(&newlines, data, len);
+	int64_t now = _cconf_now();
 
-	{	
-		size_t last_line = 0;
-		int64_t change = 0;
-		size_t i;
-		
-		for (i = 0; i < cconf->values.count; i++) {
-			CConfField* field = cconf->values.items[i];
+	for (size_t i = 0; i < watcher->watches.count; i++) {
+		_CConfWatch* watch = &watcher->watches.items[i];
 
-			if (!field->dirty) {
-				field->startl += change;
-				field->endl += change;
-				continue;
-			}
+		if (!watch->pending) {
+			continue;
+		}
 
-			field->dirty = false;
+		if (watch->deadline <= now) {
+			watch->pending = false;
+			_cconf_watcher_reload(watcher, i);
+			continue;
+		}
 
-			if (field->startl < 0) {
-				break;
-			}
+		int64_t left = watch->deadline - now;
 
-			if ((uint64_t) field->startl != last_line) {
-				_cconf_write_copy(last_line, field->startl - 1, newlines, data, f);
-			}
+		if (*timeout < 0 || left < *timeout) {
+			*timeout = (int)left;
+		}
+	}
+
+	return CCONF_STATUS_OK;
+#else
+	(void)watcher;
+	return CCONF_STATUS_WATCH;
+#endif
+}
 
-			size_t new_size = _cconf_write_field(field, f);
-			size_t old_size = (field->endl - field->startl + 1);
+// Blocks the calling thread until cconf_watcher_stop() is called
+CCONFDEF CCONF_STATUS cconf_watcher_run(CConfWatcher* watcher) {
+#ifdef _CCONF_WATCH
+	struct pollfd fds[2];
+	int timeout = -1;
+	char drain[16];
 
-			last_line = field->endl + 1;
+	fds[0].fd = watcher->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = watcher->wake[0];
+	fds[1].events = POLLIN;
 
-			field->startl += change;
-			change += new_size - old_size;
+	while (true) {
+		int res = poll(fds, 2, timeout);
 
-			field->endl = field->startl + new_size - 1;
+		if (res < 0 && errno == EINTR) {
+			continue;
 		}
 
-		// If they are the same then all lines were written
-		if (last_line != newlines.count) {
-			_cconf_write_copy(last_line, newlines.count - 1, newlines, data, f);
+		if (res < 0) {
+			return CCONF_STATUS_WATCH;
 		}
 
-		if (i != cconf->values.count) {
-			last_line = newlines.count;
-
-			if (i != 0) {	
-				fputc('\n', f);
-			}
+		if (fds[1].revents & POLLIN) {
+			while (read(watcher->wake[0], drain, sizeof(drain)) > 0);
+			return CCONF_STATUS_OK;
+		}
 
-			for (; i < cconf->values.count; i++) {
-				CConfField* field = cconf->values.items[i];
-				size_t new_size = _cconf_write_field(field, f);
+		CCONF_STATUS status = cconf_watcher_process(watcher, &timeout);
 
-				field->dirty = false;
-				field->startl = last_line + 1;
-				field->endl = field->startl + new_size - 1;
-			}
+		if (status != CCONF_STATUS_OK) {
+			return status;
 		}
 	}
+#else
+	(void)watcher;
+	return CCONF_STATUS_WATCH;
+#endif
+}
 
-defer:
-	if (f != NULL) {
-		fclose(f);
-	}
+// Can be called from any thread, or from a signal handler
+CCONFDEF void cconf_watcher_stop(CConfWatcher* watcher) {
+#ifdef _CCONF_WATCH
+	ssize_t res = write(watcher->wake[1], "", 1);
+	(void)res;
+#else
+	(void)watcher;
+#endif
+}
 
-	if (data != NULL) {
-		free(data);
+CCONFDEF void cconf_watcher_free(CConfWatcher* watcher) {
+#ifdef _CCONF_WATCH
+	for (size_t i = 0; i < watcher->watches.count; i++) {
+		free(watcher->watches.items[i].filepath);
 	}
 
-	if (newlines.items != 0) {
-		_CConf_size_t_da_free(&newlines);
+	_CConfWatch_da_free(&watcher->watches);
+
+	if (watcher->fd >= 0) {
+		close(watcher->fd);
+		close(watcher->wake[0]);
+		close(watcher->wake[1]);
 	}
+#endif
 
-	return status;
+	watcher->fd = -1;
+	watcher->wake[0] = -1;
+	watcher->wake[1] = -1;
 }
 
-// TODO: Add the ability to delete a field
-
 #endif // CCONF_IMPLEMENTATION
 #endif // CCONF_H
\ No newline at end of file
@@ -0,0 +1,123 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField *field, void *user) {
+	(void)field;
+	(*(size_t*)user)++;
+}
+
+static void load(const char *path, const CConfSchemaRule *rules, size_t count, bool strict) {
+	CConfSchema schema;
+	CConfFile cconf = cconf_init();
+	size_t fields = 0;
+
+	assert(cconf_schema_compile(&schema, rules, count, strict) == CCONF_STATUS_OK);
+	cconf.schema = &schema;
+
+	CCONF_STATUS status = cconf_load(&cconf, path, handler, &fields);
+	printf(
+		"status %d fields %zu kept %zu error %d rule %zu element %zu at %zu:%zu\n",
+		status, fields, cconf.values.count, cconf.violation.error, cconf.violation.rule,
+		cconf.violation.element, cconf.violation.row + 1, cconf.violation.col + 1
+	);
+
+	cconf_free(&cconf);
+	cconf_schema_free(&schema);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	const char *modes[] = { "fast", "safe" };
+	const char *hosts[] = { "alpha", "beta", "gamma", "delta" };
+
+	CConfSchemaRule rules[6] = { 0 };
+
+	rules[0].fieldname = "port";
+	rules[0].type = CCONF_TYPE_NUMBER;
+	rules[0].flags = CCONF_SCHEMA_REQUIRED | CCONF_SCHEMA_RANGE;
+	rules[0].min_num = 1;
+	rules[0].max_num = 65535;
+
+	rules[1].fieldname = "ratio";
+	rules[1].type = CCONF_TYPE_DECIMAL;
+	rules[1].flags = CCONF_SCHEMA_RANGE;
+	rules[1].min_dec = 0.0;
+	rules[1].max_dec = 1.0;
+
+	rules[2].fieldname = "mode";
+	rules[2].type = CCONF_TYPE_STRING;
+	rules[2].flags = CCONF_SCHEMA_ENUM | CCONF_SCHEMA_LENGTH;
+	rules[2].values = modes;
+	rules[2].values_count = 2;
+	rules[2].min_len = 1;
+	rules[2].max_len = 8;
+
+	rules[3].fieldname = "hosts";
+	rules[3].type = CCONF_TYPE_STRING_ARR;
+	rules[3].flags = CCONF_SCHEMA_ENUM | CCONF_SCHEMA_COUNT;
+	rules[3].values = hosts;
+	rules[3].values_count = 4;
+	rules[3].min_count = 1;
+	rules[3].max_count = 4;
+
+	rules[4].fieldname = "weights";
+	rules[4].type = CCONF_TYPE_NUMBER_ARR;
+	rules[4].flags = CCONF_SCHEMA_RANGE;
+	rules[4].min_num = 0;
+	rules[4].max_num = 10;
+
+	rules[5].fieldname = "timeout";
+	rules[5].type = CCONF_TYPE_NUMBER;
+
+	// Valid
+	load(argv[1], rules, 6, true);
+
+	// Unknown field in strict mode
+	load(argv[1], rules, 4, true);
+
+	// Element out of range
+	rules[4].max_num = 3;
+	load(argv[1], rules, 6, true);
+	rules[4].max_num = 10;
+
+	// Too many elements
+	rules[3].max_count = 2;
+	load(argv[1], rules, 6, true);
+	rules[3].max_count = 4;
+
+	// String not in the enum set
+	rules[2].values_count = 1;
+	rules[2].values = &modes[1];
+	load(argv[1], rules, 6, true);
+	rules[2].values = modes;
+	rules[2].values_count = 2;
+
+	// Wrong type
+	rules[1].type = CCONF_TYPE_NUMBER;
+	load(argv[1], rules, 6, true);
+	rules[1].type = CCONF_TYPE_DECIMAL;
+
+	// Numbers are not decimals
+	rules[0].type = CCONF_TYPE_DECIMAL;
+	load(argv[1], rules, 6, true);
+	rules[0].type = CCONF_TYPE_NUMBER;
+
+	// Missing required field
+	rules[5].flags = CCONF_SCHEMA_REQUIRED;
+	load(argv[1], rules, 6, false);
+
+	// Rules for the same field are rejected
+	CConfSchema schema;
+
+	rules[5].fieldname = "ratio";
+	assert(cconf_schema_compile(&schema, rules, 6, true) == CCONF_STATUS_SCHEMA);
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+typedef struct {
+	CConfField *allow;
+	CConfField *ports;
+} Options;
+
+void handler(CConfField *field, void *user) {
+	Options *opts = (Options*)user;
+
+	if (strcmp(field->fieldname, "allow") == 0) {
+		assert(field->type == CCONF_TYPE_STRING_ARR);
+		assert(field->index != NULL);
+		opts->allow = field;
+		return;
+	} else if (strcmp(field->fieldname, "ports") == 0) {
+		assert(field->type == CCONF_TYPE_NUMBER_ARR);
+		assert(field->index != NULL);
+		opts->ports = field;
+		return;
+	}
+
+	assert(0);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	Options options = { 0 };
+	CConfFile cconf = cconf_init();
+	cconf.flags |= CCONF_FLAG_INDEX_ARRAYS;
+
+	if (cconf_load(&cconf, argv[1], handler, &options) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	assert(cconf_array_contains_string(options.allow, "10.0.0.2", 8));
+	assert(cconf_array_contains_string(options.allow, "192.168.1.1", 11));
+	assert(!cconf_array_contains_string(options.allow, "192.168.1", 9));
+	assert(!cconf_array_contains_string(options.allow, "", 0));
+
+	assert(cconf_array_contains_number(options.ports, 443));
+	assert(cconf_array_contains_number(options.ports, -1));
+	assert(!cconf_array_contains_number(options.ports, 0));
+
+	// Appending to the array invalidates the index
+	{
+		CConfAs as;
+		as.num = 9090;
+		CConfAs_da_append(&options.ports->arr, as);
+	}
+
+	assert(cconf_array_contains_number(options.ports, 9090));
+
+	// Changing an element in place requires dropping the index
+	cconf_string_free(options.allow->arr.items[0].str);
+	options.allow->arr.items[0].str = cconf_string_new("127.0.0.1");
+	cconf_array_index_free(options.allow);
+
+	assert(options.allow->index == NULL);
+	assert(cconf_array_contains_string(options.allow, "127.0.0.1", 9));
+	assert(!cconf_array_contains_string(options.allow, "10.0.0.1", 8));
+	assert(options.allow->index != NULL);
+
+	printf("allow %zu ports %zu\n", options.allow->arr.count, options.ports->arr.count);
+
+	cconf_free(&cconf);
+	return 0;
+}
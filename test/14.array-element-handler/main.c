@@ -0,0 +1,76 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+typedef struct {
+	int64_t sum;
+	size_t elements;
+} Stats;
+
+bool element_handler(CConfField *field, size_t index, CConfAs *value, void *user) {
+	Stats *stats = (Stats*)user;
+	stats->elements++;
+
+	if (strcmp(field->fieldname, "buckets") == 0) {
+		// Consume the element without storing it
+		assert(field->arr.count == 0);
+		stats->sum += value->num;
+		return false;
+	} else if (strcmp(field->fieldname, "names") == 0) {
+		// Only keep every other element
+		if (index % 2 == 1) {
+			cconf_string_free(value->str);
+			return false;
+		}
+
+		return true;
+	}
+
+	return true;
+}
+
+void handler(CConfField *field, void *user) {
+	(void)user;
+
+	if (strcmp(field->fieldname, "buckets") == 0) {
+		assert(field->type == CCONF_TYPE_NUMBER_ARR);
+		assert(field->arr.count == 0);
+		assert(field->arr.items == NULL);
+	} else if (strcmp(field->fieldname, "names") == 0) {
+		assert(field->type == CCONF_TYPE_STRING_ARR);
+		assert(field->arr.count == 3);
+		assert(field->arr.capacity == 5);
+		assert(strcmp(field->arr.items[0].str, "a,b") == 0);
+		assert(strcmp(field->arr.items[1].str, "e\"f") == 0);
+		assert(strcmp(field->arr.items[2].str, "h") == 0);
+	} else if (strcmp(field->fieldname, "flags") == 0) {
+		assert(field->type == CCONF_TYPE_BOOLEAN_ARR);
+		assert(field->arr.count == 2);
+		assert(field->arr.capacity == 2);
+	} else {
+		assert(0);
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	Stats stats = { 0 };
+	CConfFile cconf = cconf_init();
+	cconf.flags |= CCONF_FLAG_PRECOUNT_ARRAYS;
+	cconf.element_handler = element_handler;
+
+	if (cconf_load(&cconf, argv[1], handler, &stats) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	printf("sum %" PRId64 " elements %zu\n", stats.sum, stats.elements);
+
+	cconf_free(&cconf);
+	return 0;
+}
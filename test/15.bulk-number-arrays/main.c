@@ -0,0 +1,55 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField *field, void *user) {
+	(void)user;
+
+	if (strcmp(field->fieldname, "buckets") == 0) {
+		assert(field->type == CCONF_TYPE_NUMBER_ARR);
+		assert(field->arr.count == 10);
+		assert(field->arr.items[0].num == 0);
+		assert(field->arr.items[1].num == 1);
+		assert(field->arr.items[2].num == -1);
+		assert(field->arr.items[3].num == 42);
+		assert(field->arr.items[4].num == 12345678);
+		assert(field->arr.items[5].num == 123456789012345678ll);
+		assert(field->arr.items[6].num == INT64_MAX);
+		assert(field->arr.items[7].num == INT64_MIN);
+		assert(field->arr.items[8].num == INT64_MAX);
+		assert(field->arr.items[9].num == 7);
+		return;
+	} else if (strcmp(field->fieldname, "weights") == 0) {
+		assert(field->type == CCONF_TYPE_DECIMAL_ARR);
+		assert(field->arr.count == 8);
+		assert(field->arr.items[0].dec == 0.5);
+		assert(field->arr.items[1].dec == -0.25);
+		assert(field->arr.items[2].dec == 3.0);
+		assert(field->arr.items[3].dec == strtod("0.1", NULL));
+		assert(field->arr.items[4].dec == strtod("1234567.1234567", NULL));
+		assert(field->arr.items[5].dec == 0.0);
+		assert(field->arr.items[6].dec == strtod("0.30000000000000004441", NULL));
+		assert(field->arr.items[7].dec == strtod("123456789012345678901234.5", NULL));
+		return;
+	}
+
+	assert(0);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	cconf_free(&cconf);
+	return 0;
+}
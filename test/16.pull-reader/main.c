@@ -0,0 +1,74 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfReader reader;
+	CConfField field;
+	CCONF_STATUS status;
+
+	// Read all fields
+	if (cconf_reader_open(&reader, argv[1]) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	while ((status = cconf_reader_next(&reader, &field)) == CCONF_STATUS_OK) {
+		printf("%s type %d lines %" PRId64 "-%" PRId64 "\n", field.fieldname, field.type, field.startl, field.endl);
+		cconf_field_clear(&field);
+	}
+
+	assert(status == CCONF_STATUS_EOF);
+	assert(cconf_reader_next(&reader, &field) == CCONF_STATUS_EOF);
+	cconf_reader_close(&reader);
+
+	// Stop early
+	if (cconf_reader_open(&reader, argv[1]) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	assert(cconf_reader_next(&reader, &field) == CCONF_STATUS_OK);
+	assert(strcmp(field.fieldname, "first") == 0);
+	assert(field.as.num == 1);
+	cconf_field_clear(&field);
+	cconf_reader_close(&reader);
+
+	// Syntax errors are returned instead of exiting
+	{
+		const char data[] = "valid = 1\ninvalid = = 2\n";
+		char buf[CCONF_ERROR_SIZE];
+
+		cconf_reader_open_buffer(&reader, data, sizeof(data) - 1);
+
+		assert(cconf_reader_next(&reader, &field) == CCONF_STATUS_OK);
+		cconf_field_clear(&field);
+
+		assert(cconf_reader_next(&reader, &field) == CCONF_STATUS_PARSE);
+		cconf_reader_format_error(&reader, buf);
+		printf("%s\n", buf);
+
+		cconf_reader_close(&reader);
+	}
+
+	// Malformed values too
+	{
+		const char data[] = "flag = tru\n";
+		char buf[CCONF_ERROR_SIZE];
+
+		cconf_reader_open_buffer(&reader, data, sizeof(data) - 1);
+
+		assert(cconf_reader_next(&reader, &field) == CCONF_STATUS_PARSE);
+		cconf_reader_format_error(&reader, buf);
+		printf("%s\n", buf);
+
+		cconf_reader_close(&reader);
+	}
+
+	return 0;
+}
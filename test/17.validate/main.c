@@ -0,0 +1,54 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfDiagnostic items[2];
+	CConfDiagnostics diagnostics = { items, 2, 0, 0 };
+	char buf[CCONF_ERROR_SIZE];
+
+	// All errors are counted, but only the first ones are stored
+	assert(cconf_validate(argv[1], &diagnostics) == CCONF_STATUS_PARSE);
+	printf("count %zu total %zu\n", diagnostics.count, diagnostics.total);
+
+	for (size_t i = 0; i < diagnostics.count; i++) {
+		cconf_diagnostic_format(&diagnostics.items[i], buf);
+		printf("%s\n", buf);
+	}
+
+	CConfDiagnostic all[8];
+	diagnostics = (CConfDiagnostics){ all, 8, 0, 0 };
+
+	assert(cconf_validate(argv[1], &diagnostics) == CCONF_STATUS_PARSE);
+	assert(diagnostics.count == diagnostics.total);
+
+	for (size_t i = 0; i < diagnostics.count; i++) {
+		printf("row %zu col %zu\n", diagnostics.items[i].row, diagnostics.items[i].col);
+	}
+
+	// Valid buffers report nothing
+	const char valid[] = "first = 1\nsecond = [\"x\", \"y\"]\n";
+	assert(cconf_validate_buffer(valid, sizeof(valid), &diagnostics) == CCONF_STATUS_OK);
+	assert(diagnostics.total == 0);
+
+	// Only the exact words are booleans
+	const char* literals[] = { "a = tru\n", "a = falsey\n", "a = [true, tr]\n" };
+
+	for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+		assert(cconf_validate_buffer(literals[i], strlen(literals[i]), &diagnostics) == CCONF_STATUS_PARSE);
+		cconf_diagnostic_format(&diagnostics.items[0], buf);
+		printf("%s\n", buf);
+	}
+
+	// Missing files are reported through the status
+	assert(cconf_validate("missing.ini", &diagnostics) == CCONF_STATUS_FOPEN);
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)user;
+	printf("%s type %d lines %" PRId64 "-%" PRId64 "\n", field->fieldname, field->type, field->startl, field->endl);
+}
+
+uint8_t selector(const char* name, size_t len, void* user) {
+	size_t* seen = (size_t*)user;
+	(*seen)++;
+
+	if (len == 4 && strncmp(name, "tags", len) == 0) {
+		return CCONF_SELECT_STOP;
+	}
+
+	return name[0] == 'p' ? CCONF_SELECT_LOAD : CCONF_SELECT_SKIP;
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	// Load a set of keys, stopping once all of them are found
+	const char* keys[] = { "verbose", "host", "port", "missing", "host" };
+	CConfFile cconf = cconf_init();
+
+	assert(cconf_load_keys(&cconf, argv[1], keys, 3, handler, NULL) == CCONF_STATUS_OK);
+	assert(cconf.values.count == 3);
+	assert(cconf.values.items[0]->as.num == 8080);
+	assert(strcmp(cconf.values.items[1]->as.str, "localhost") == 0);
+	assert(cconf.values.items[2]->as.boolean == true);
+	cconf_free(&cconf);
+
+	// Keys that are not in the file make the whole file to be scanned,
+	// and duplicated keys are only counted once
+	cconf = cconf_init();
+	assert(cconf_load_keys(&cconf, argv[1], keys, 5, handler, NULL) == CCONF_STATUS_OK);
+	assert(cconf.values.count == 3);
+	cconf_free(&cconf);
+	printf("---\n");
+
+	// Selector
+	size_t seen = 0;
+	cconf = cconf_init();
+	cconf.selector = selector;
+
+	assert(cconf_load(&cconf, argv[1], handler, &seen) == CCONF_STATUS_OK);
+	assert(cconf.values.count == 2);
+	printf("seen %zu\n", seen);
+	cconf_free(&cconf);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	CConfField** fields = (CConfField**)user;
+
+	if (strcmp(field->fieldname, "count") == 0) {
+		fields[0] = field;
+	}
+	else if (strcmp(field->fieldname, "name") == 0) {
+		fields[1] = field;
+	}
+}
+
+// Checks that the cached buffer matches the file on disk
+void check_cache(CConfFile* cconf) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(cconf->filepath, &len, &data) == CCONF_STATUS_OK);
+	assert(cconf->data != NULL);
+	assert(cconf->len == len);
+	assert(memcmp(cconf->data, data, len) == 0);
+
+	size_t lines = 0;
+	for (size_t i = 0; i < len; i++) {
+		lines += data[i] == '\n';
+	}
+
+	assert(cconf->newlines.count == lines);
+	printf("len %zu lines %zu\n", len, lines);
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfField* fields[2] = { 0 };
+	CConfFile cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_KEEP_BUFFER;
+
+	if (cconf_load(&cconf, argv[1], handler, fields) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	check_cache(&cconf);
+
+	// The cached buffer is kept updated after every write
+	fields[0]->as.num = 1000;
+	fields[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	check_cache(&cconf);
+
+	cconf_string_free(fields[1]->as.str);
+	fields[1]->as.str = cconf_string_new("multi\nline");
+	fields[1]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	check_cache(&cconf);
+
+	// External modifications are detected, and the file is read again
+	{
+		FILE* f = fopen(argv[1], "ab");
+		fputs("# external\n", f);
+		fclose(f);
+	}
+
+	fields[0]->as.num = 7;
+	fields[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	check_cache(&cconf);
+
+	cconf_free(&cconf);
+	assert(cconf.data == NULL);
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+// Prints the spans of all fields, and checks them against the file
+void print_spans(CConfFile* cconf) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(cconf->filepath, &len, &data) == CCONF_STATUS_OK);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+		CConfSpan span = cconf_field_span(cconf, field);
+
+		assert(span.start >= 0 && span.end <= (int64_t)len && span.start < span.end);
+		assert(span.start == 0 || data[span.start - 1] == '\n');
+		assert(data[span.end - 1] == '\n');
+
+		// Every span starts at the line of its field
+		const char* name = &data[span.start];
+		while (*name == ' ' || *name == '\t') {
+			name++;
+		}
+		assert(strncmp(name, field->fieldname, CCONF_STRING_SIZE(field->fieldname)) == 0);
+
+		printf(
+			"%s bytes %" PRId64 "-%" PRId64 " lines %" PRId64 "-%" PRId64 "\n",
+			field->fieldname, span.start, span.end, span.startl, span.endl
+		);
+	}
+
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	print_spans(&cconf);
+
+	CConfField* first = cconf.values.items[0];
+	CConfField* text = cconf.values.items[1];
+	CConfField* list = cconf.values.items[3];
+
+	// Shrink and grow fields across several writes
+	cconf_string_free(text->as.str);
+	text->as.str = cconf_string_new("single");
+	text->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	printf("---\n");
+	print_spans(&cconf);
+
+	first->as.num = 123456;
+	first->dirty = true;
+	CConfAs as = { .num = 3 };
+	CConfAs_da_append(&list->arr, as);
+	list->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	printf("---\n");
+	print_spans(&cconf);
+
+	// Appended fields get a span as well
+	CConfField* field = cconf_field_new(cconf_string_new("appended"), CCONF_TYPE_STRING);
+	field->as.str = cconf_string_new("two\nlines");
+	cconf_append_field(&cconf, field);
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+
+	text->as.str[0] = 'S';
+	text->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	printf("---\n");
+	print_spans(&cconf);
+
+	cconf_free(&cconf);
+	return 0;
+}
@@ -0,0 +1,70 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	int64_t numbers[] = { 0, 7, -7, 10, 99, 100, -12345, 9876543210, INT64_MAX, INT64_MIN };
+	double decimals[] = { 0.0, -0.0, 0.04, -0.05, 0.25, 0.35, 0.75, 2.5, -69.95, 1e-300, 123456789.125, 1e20, -1e300 };
+	bool flags[] = { true, false };
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	CConfField* field = cconf.values.items[0];
+	field->arr.count = 0;
+	for (size_t i = 0; i < sizeof(numbers) / sizeof(*numbers); i++) {
+		CConfAs as = { .num = numbers[i] };
+		CConfAs_da_append(&field->arr, as);
+	}
+	field->dirty = true;
+
+	field = cconf.values.items[1];
+	field->arr.count = 0;
+	for (size_t i = 0; i < sizeof(decimals) / sizeof(*decimals); i++) {
+		CConfAs as = { .dec = decimals[i] };
+		CConfAs_da_append(&field->arr, as);
+	}
+	field->dirty = true;
+
+	field = cconf.values.items[2];
+	field->arr.count = 0;
+	for (size_t i = 0; i < sizeof(flags) / sizeof(*flags); i++) {
+		CConfAs as = { .boolean = flags[i] };
+		CConfAs_da_append(&field->arr, as);
+	}
+	field->dirty = true;
+
+	// Long runs with escapes and newlines at every position of a word
+	field = cconf.values.items[3];
+	cconf_string_free(field->as.str);
+	field->as.str = cconf_string_new(
+		"-----BEGIN CERTIFICATE-----\nMIIBszCCAVmgAwIBAgIU\n-----END CERTIFICATE-----\n"
+		"{\"key\": \"C:\\\\path\", \"list\": [1, 2]}\"\\\n"
+	);
+	field->dirty = true;
+
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	cconf_free(&cconf);
+
+	// Check if the file is still valid
+	cconf = cconf_init();
+	assert(cconf_load(&cconf, argv[1], handler, NULL) == CCONF_STATUS_OK);
+	cconf_free(&cconf);
+
+	return 0;
+}
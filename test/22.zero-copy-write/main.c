@@ -0,0 +1,83 @@
+#define _GNU_SOURCE
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	CConfField** fields = (CConfField**)user;
+
+	if (strcmp(field->fieldname, "count") == 0) {
+		fields[0] = field;
+	}
+	else if (strcmp(field->fieldname, "ratio") == 0) {
+		fields[1] = field;
+	}
+}
+
+void count(CConfField* field, void* user) {
+	(void)field;
+	(*(size_t*)user)++;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfField* fields[2] = { 0 };
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, fields) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// Unchanged spans are written straight from the old contents
+	fields[0]->as.num = 1000;
+	fields[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// Unchanged spans are copied between files without being read
+	cconf.flags |= CCONF_FLAG_COPY_RANGE;
+	fields[1]->as.dec = 2.5;
+	fields[1]->dirty = true;
+
+	CConfField* added = cconf_field_new(cconf_string_new("added"), CCONF_TYPE_BOOLEAN);
+	added->as.boolean = true;
+	cconf_append_field(&cconf, added);
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	fields[0]->as.num = 2;
+	fields[0]->dirty = true;
+	added->as.boolean = false;
+	added->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	CConfSpan span = cconf_field_span(&cconf, added);
+	printf("added %d %d %d %d\n", (int)span.start, (int)span.end, (int)span.startl, (int)span.endl);
+
+	cconf_free(&cconf);
+
+	// The result loads back
+	size_t fields_count = 0;
+	cconf = cconf_init();
+	assert(cconf_load(&cconf, argv[1], count, &fields_count) == CCONF_STATUS_OK);
+	printf("%zu fields\n", fields_count);
+	cconf_free(&cconf);
+
+	return 0;
+}
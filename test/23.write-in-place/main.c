@@ -0,0 +1,77 @@
+#define _POSIX_C_SOURCE 200809L
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	CConfField** fields = (CConfField**)user;
+
+	if (strcmp(field->fieldname, "state") == 0) {
+		fields[0] = field;
+	}
+	else if (strcmp(field->fieldname, "count") == 0) {
+		fields[1] = field;
+	}
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s-- %zu\n", (int)len, data, len);
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfField* fields[2] = { 0 };
+	CConfFile cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_WRITE_IN_PLACE;
+
+	if (cconf_load(&cconf, argv[1], handler, fields) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// The file gets shorter, and is truncated
+	fields[1]->as.num = 7;
+	fields[1]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// The file gets longer, and the suffix is moved
+	cconf_string_free(fields[0]->as.str);
+	fields[0]->as.str = cconf_string_new("stopped\nafter a while");
+	fields[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// Only the appended text is written
+	CConfField* added = cconf_field_new(cconf_string_new("added"), CCONF_TYPE_NUMBER);
+	added->as.num = 1;
+	cconf_append_field(&cconf, added);
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// The buffer kept in memory is patched the same way
+	cconf_free(&cconf);
+	cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_WRITE_IN_PLACE | CCONF_FLAG_KEEP_BUFFER;
+	assert(cconf_load(&cconf, argv[1], handler, fields) == CCONF_STATUS_OK);
+
+	fields[1]->as.num = 42;
+	fields[1]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	printf("cached %zu\n", cconf.len);
+
+	cconf_free(&cconf);
+
+	return 0;
+}
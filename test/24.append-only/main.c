@@ -0,0 +1,80 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s-- %zu\n", (int)len, data, len);
+	free(data);
+}
+
+CConfField* add_node(CConfFile* cconf, const char* name, const char* address) {
+	CConfField* field = cconf_field_new(cconf_string_new(name), CCONF_TYPE_STRING);
+	field->as.str = cconf_string_new(address);
+	cconf_append_field(cconf, field);
+
+	return field;
+}
+
+void print_span(CConfFile* cconf, CConfField* field) {
+	CConfSpan span = cconf_field_span(cconf, field);
+	printf("%s %d %d %d %d\n", field->fieldname, (int)span.start, (int)span.end, (int)span.startl, (int)span.endl);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// Only the new fields are written at the end of the file
+	CConfField* b = add_node(&cconf, "nodeB", "10.0.0.2");
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+
+	CConfField* c = add_node(&cconf, "nodeC", "10.0.0.3\nbackup");
+	CConfField* d = add_node(&cconf, "nodeD", "10.0.0.4");
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	print_span(&cconf, b);
+	print_span(&cconf, c);
+	print_span(&cconf, d);
+
+	// Nothing is written when nothing changed
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+
+	// Changing an existing field goes through a full write
+	cconf_string_free(b->as.str);
+	b->as.str = cconf_string_new("10.0.0.20");
+	b->dirty = true;
+	CConfField* e = add_node(&cconf, "nodeE", "10.0.0.5");
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+
+	CConfField* f = add_node(&cconf, "nodeF", "10.0.0.6");
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	print_span(&cconf, d);
+	print_span(&cconf, e);
+	print_span(&cconf, f);
+
+	cconf_free(&cconf);
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 200809L
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	CConfField** fields = (CConfField**)user;
+	size_t i = 0;
+
+	while (fields[i] != NULL) {
+		i++;
+	}
+
+	fields[i] = field;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+ino_t inode(const char* filepath) {
+	struct stat st;
+	assert(stat(filepath, &st) == 0);
+	return st.st_ino;
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfField* fields[4] = { 0 };
+	CConfFile cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_ATOMIC_WRITE;
+	cconf.commit_threshold = 3;
+
+	if (cconf_load(&cconf, argv[1], handler, fields) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	ino_t old = inode(argv[1]);
+
+	// Deferred until three fields are dirty
+	fields[0]->as.num = 10;
+	fields[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	fields[1]->as.num = 20;
+	fields[1]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	fields[2]->as.num = 30;
+	fields[2]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// The file was replaced by a new one
+	printf("replaced %d\n", inode(argv[1]) != old);
+
+	// Deferred until the interval passes, or until flushed
+	cconf.commit_threshold = 0;
+	cconf.commit_interval = 60 * 60 * 1000;
+
+	fields[0]->as.num = 100;
+	fields[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	assert(cconf_flush(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	cconf_free(&cconf);
+
+	return 0;
+}
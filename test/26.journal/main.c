@@ -0,0 +1,140 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)user;
+	printf("%s=%" PRId64 "%s\n", field->fieldname, field->as.num, field->journaled ? " (journal)" : "");
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	if (_cconf_read_entire_file(filepath, &len, &data) != CCONF_STATUS_OK) {
+		printf("(missing)\n--\n");
+		return;
+	}
+
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+void dump_all(const char* filepath, const char* journal) {
+	dump(filepath);
+	dump(journal);
+}
+
+CConfField* find(CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	char journal[512];
+	snprintf(journal, sizeof(journal), "%s.journal", argv[1]);
+	remove(journal);
+
+	CConfFile cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_JOURNAL;
+	cconf.journal_threshold = 32;
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// Changes only go to the journal
+	find(&cconf, "alpha")->as.num = 10;
+	find(&cconf, "alpha")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+
+	CConfField* added = cconf_field_new(cconf_string_new("gamma"), CCONF_TYPE_NUMBER);
+	added->as.num = 3;
+	cconf_append_field(&cconf, added);
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump_all(argv[1], journal);
+	cconf_free(&cconf);
+
+	// The journal is replayed over the file
+	cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_JOURNAL;
+	cconf.journal_threshold = 32;
+	assert(cconf_load(&cconf, argv[1], handler, NULL) == CCONF_STATUS_OK);
+
+	// Past the threshold the journal is folded into the file
+	find(&cconf, "alpha")->as.num = 100;
+	find(&cconf, "alpha")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump_all(argv[1], journal);
+
+	find(&cconf, "beta")->as.num = 200;
+	find(&cconf, "beta")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump_all(argv[1], journal);
+	cconf_free(&cconf);
+
+	// An incomplete record is ignored, and dropped by the next compaction
+	{
+		FILE* f = fopen(journal, "ab");
+		fputs("gamma=30\nalpha=1", f);
+		fclose(f);
+	}
+
+	cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_JOURNAL;
+	assert(cconf_load(&cconf, argv[1], handler, NULL) == CCONF_STATUS_OK);
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump_all(argv[1], journal);
+	cconf_free(&cconf);
+
+	// Records are checked against the schema like the fields of the file
+	const char* records[] = { "beta=7\nalpha=500\n", "beta=8\ndelta=5\n", "beta=9\ngamma=-1\n" };
+	CConfSchemaRule rules[3] = { 0 };
+	CConfSchema schema;
+
+	rules[0].fieldname = "alpha";
+	rules[0].type = CCONF_TYPE_NUMBER;
+	rules[0].flags = CCONF_SCHEMA_RANGE;
+	rules[0].min_num = 0;
+	rules[0].max_num = 100;
+	rules[1].fieldname = "beta";
+	rules[1].type = CCONF_TYPE_NUMBER;
+	rules[2].fieldname = "gamma";
+	rules[2].type = CCONF_TYPE_NUMBER;
+	assert(cconf_schema_compile(&schema, rules, 3, true) == CCONF_STATUS_OK);
+
+	for (size_t i = 0; i < sizeof(records) / sizeof(records[0]); i++) {
+		FILE* f = fopen(journal, "wb");
+		fputs(records[i], f);
+		fclose(f);
+
+		cconf = cconf_init();
+		cconf.flags = CCONF_FLAG_JOURNAL;
+		cconf.schema = &schema;
+
+		CCONF_STATUS status = cconf_load(&cconf, argv[1], handler, NULL);
+		printf(
+			"status %d kept %zu error %d rule %zu at %zu\n",
+			status, cconf.values.count, cconf.violation.error,
+			cconf.violation.rule, cconf.violation.row + 1
+		);
+		cconf_free(&cconf);
+	}
+
+	cconf_schema_free(&schema);
+	remove(journal);
+
+	return 0;
+}
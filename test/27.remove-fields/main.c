@@ -0,0 +1,86 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+CConfField* find(CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+void print_spans(CConfFile* cconf) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+		CConfSpan span = cconf_field_span(cconf, field);
+
+		printf(
+			"%s%s %d %d %d %d\n",
+			field->fieldname, field->removed ? " (removed)" : "",
+			(int)span.start, (int)span.end, (int)span.startl, (int)span.endl
+		);
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// Removed fields stay inside `values` until enough of them are written
+	cconf_remove_field(&cconf, find(&cconf, "stale"));
+	find(&cconf, "older")->as.num = 40;
+	find(&cconf, "older")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&cconf);
+
+	// Appended fields can be removed before they are written
+	CConfField* added = cconf_field_new(cconf_string_new("added"), CCONF_TYPE_NUMBER);
+	added->as.num = 6;
+	cconf_append_field(&cconf, added);
+	cconf_remove_field(&cconf, added);
+
+	cconf_remove_field(&cconf, find(&cconf, "first"));
+	cconf_remove_field(&cconf, find(&cconf, "last"));
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&cconf);
+
+	// Later writes still find the remaining fields
+	find(&cconf, "older")->as.num = 400;
+	find(&cconf, "older")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&cconf);
+
+	cconf_free(&cconf);
+
+	return 0;
+}
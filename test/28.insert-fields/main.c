@@ -0,0 +1,102 @@
+#define _POSIX_C_SOURCE 200809L
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+CConfField* find(CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+CConfField* number(const char* name, int64_t num) {
+	CConfField* field = cconf_field_new(cconf_string_new(name), CCONF_TYPE_NUMBER);
+	field->as.num = num;
+	return field;
+}
+
+// Prints the file, and checks that every field is where its span says
+void check(CConfFile* cconf) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(cconf->filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+		CConfSpan span = cconf_field_span(cconf, field);
+		size_t line = 0;
+
+		if (field->removed) {
+			continue;
+		}
+
+		assert(field->pos == i);
+		assert(span.end <= (int64_t)len);
+		assert(strncmp(&data[span.start], field->fieldname, CCONF_STRING_SIZE(field->fieldname)) == 0);
+
+		for (int64_t j = 0; j < span.start; j++) {
+			line += data[j] == '\n';
+		}
+
+		assert((int64_t)line == span.startl);
+		printf("%s %d %d %d %d\n", field->fieldname, (int)span.start, (int)span.end, (int)span.startl, (int)span.endl);
+	}
+
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	CConfField* one = number("one", 10);
+	CConfField* two = number("two", 20);
+
+	cconf_insert_field(&cconf, find(&cconf, "first"), one);
+	cconf_insert_field(&cconf, one, two);
+	cconf_insert_field(&cconf, find(&cconf, "text"), number("three", 30));
+	cconf_append_field(&cconf, number("appended", 40));
+
+	// Inserted after a field that changed, and after a removed one
+	find(&cconf, "middle")->as.num = 200;
+	find(&cconf, "middle")->dirty = true;
+	cconf_insert_field(&cconf, find(&cconf, "middle"), number("four", 50));
+	cconf_remove_field(&cconf, find(&cconf, "last"));
+	cconf_insert_field(&cconf, find(&cconf, "last"), number("five", 60));
+
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	check(&cconf);
+
+	// Only the part of the file after the insertion is written again
+	cconf.flags = CCONF_FLAG_WRITE_IN_PLACE;
+	cconf_insert_field(&cconf, find(&cconf, "four"), number("six", 70));
+	two->as.num = 2000;
+	two->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	check(&cconf);
+
+	cconf_free(&cconf);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+CConfField* find(CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+	CConfBuffer buf = { 0 };
+	size_t len;
+	char* data;
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// Canonical text of every field
+	cconf_serialize(&cconf, &buf);
+	printf("%.*s--\n", (int)buf.count, buf.items);
+	buf.count = 0;
+
+	// Unchanged fields keep their original text
+	assert(cconf_serialize_patched(&cconf, &buf) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)buf.count, buf.items);
+	buf.count = 0;
+
+	find(&cconf, "port")->as.num = 9090;
+	find(&cconf, "port")->dirty = true;
+	cconf_remove_field(&cconf, find(&cconf, "debug"));
+
+	CConfField* inserted = cconf_field_new(cconf_string_new("timeout"), CCONF_TYPE_NUMBER);
+	inserted->as.num = 30;
+	cconf_insert_field(&cconf, find(&cconf, "host"), inserted);
+
+	CConfField* appended = cconf_field_new(cconf_string_new("retries"), CCONF_TYPE_NUMBER);
+	appended->as.num = 3;
+	cconf_append_field(&cconf, appended);
+
+	cconf_serialize(&cconf, &buf);
+	printf("%.*s--\n", (int)buf.count, buf.items);
+	buf.count = 0;
+
+	// The file is not touched, and the fields stay dirty
+	assert(cconf_serialize_patched(&cconf, &buf) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)buf.count, buf.items);
+	assert(find(&cconf, "port")->dirty && inserted->dirty && appended->dirty);
+
+	assert(_cconf_read_entire_file(argv[1], &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+
+	// Writing produces the same text
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	assert(_cconf_read_entire_file(argv[1], &len, &data) == CCONF_STATUS_OK);
+	assert(len == buf.count && memcmp(data, buf.items, len) == 0);
+	free(data);
+
+	cconf_buffer_free(&buf);
+	cconf_free(&cconf);
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+CConfField* find(CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+void print_spans(CConfFile* cconf) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+		CConfSpan span = cconf_field_span(cconf, field);
+
+		printf(
+			"%s %d %d %d %d, value %d %d %d %d\n",
+			field->fieldname,
+			(int)span.start, (int)span.end, (int)span.startl, (int)span.endl,
+			(int)field->value.start, (int)field->value.end, (int)field->value.startl, (int)field->value.endl
+		);
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	print_spans(&cconf);
+
+	// Unchanged values are kept as they are, comments included
+	find(&cconf, "weights")->dirty = true;
+	find(&cconf, "hosts")->dirty = true;
+	find(&cconf, "port")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// Only the changed elements are formatted again
+	find(&cconf, "weights")->arr.items[2].dec = 8.5;
+	find(&cconf, "weights")->dirty = true;
+	CConfString* old = find(&cconf, "hosts")->arr.items[0].str;
+	find(&cconf, "hosts")->arr.items[0].str = cconf_string_new("new\"host");
+	cconf_string_free(old);
+	find(&cconf, "hosts")->dirty = true;
+	find(&cconf, "port")->as.num = 9090;
+	find(&cconf, "port")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&cconf);
+
+	// Elements are dropped and added after the last one
+	find(&cconf, "weights")->arr.count = 1;
+	find(&cconf, "weights")->dirty = true;
+	CConfAs as = { .boolean = true };
+	CConfAs_da_append(&find(&cconf, "flags")->arr, as);
+	find(&cconf, "flags")->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&cconf);
+
+	// Elements of a different type are formatted again
+	CConfField* weights = find(&cconf, "weights");
+	weights->type = CCONF_TYPE_NUMBER_ARR;
+	weights->arr.items[0].num = 1;
+	weights->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&cconf);
+
+	cconf_free(&cconf);
+
+	// The file still parses to the same values
+	cconf = cconf_init();
+	assert(cconf_load(&cconf, argv[1], handler, NULL) == CCONF_STATUS_OK);
+	assert(find(&cconf, "weights")->type == CCONF_TYPE_NUMBER_ARR);
+	assert(find(&cconf, "flags")->arr.count == 3);
+	assert(strcmp(find(&cconf, "hosts")->arr.items[0].str, "new\"host") == 0);
+	assert(find(&cconf, "port")->as.num == 9090);
+	cconf_free(&cconf);
+
+	return 0;
+}
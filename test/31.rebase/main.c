@@ -0,0 +1,110 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+CConfField* find(CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+void set(CConfFile* cconf, const char* name, int64_t num) {
+	find(cconf, name)->as.num = num;
+	find(cconf, name)->dirty = true;
+}
+
+void print_spans(CConfFile* cconf) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		CConfField* field = cconf->values.items[i];
+		CConfSpan span = cconf_field_span(cconf, field);
+
+		printf(
+			"%s%s %d %d %d %d\n",
+			field->fieldname, field->removed ? " (removed)" : "",
+			(int)span.start, (int)span.end, (int)span.startl, (int)span.endl
+		);
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	// Two processes sharing the same file
+	CConfFile first = cconf_init();
+	CConfFile second = cconf_init();
+
+	first.flags = CCONF_FLAG_REBASE;
+	second.flags = CCONF_FLAG_REBASE | CCONF_FLAG_KEEP_BUFFER;
+
+	if (
+		cconf_load(&first, argv[1], handler, NULL) != CCONF_STATUS_OK ||
+		cconf_load(&second, argv[1], handler, NULL) != CCONF_STATUS_OK
+	) {
+		return 2;
+	}
+
+	// Same size and, most likely, the same second: only the hash tells
+	set(&second, "beta", 5);
+	assert(cconf_write(&second) == CCONF_STATUS_OK);
+
+	set(&first, "delta", 8);
+	assert(cconf_write(&first) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	// Fields removed by the other side are appended again when changed
+	cconf_remove_field(&second, find(&second, "gamma"));
+	CConfField* added = cconf_field_new(cconf_string_new("epsilon"), CCONF_TYPE_NUMBER);
+	added->as.num = 6;
+	cconf_append_field(&second, added);
+	set(&second, "alpha", 100);
+	assert(cconf_write(&second) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	set(&first, "gamma", 30);
+	set(&first, "alpha", 10);
+	assert(cconf_write(&first) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&first);
+
+	// Fields removed by the other side are dropped when unchanged
+	cconf_remove_field(&first, find(&first, "delta"));
+	assert(cconf_write(&first) == CCONF_STATUS_OK);
+
+	set(&second, "beta", 50);
+	assert(cconf_write(&second) == CCONF_STATUS_OK);
+	dump(argv[1]);
+	print_spans(&second);
+
+	// Without changes from the other side the file is only checked
+	set(&second, "beta", 500);
+	assert(cconf_write(&second) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	cconf_free(&first);
+	cconf_free(&second);
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+const CConfField* find(const CConfFile* cconf, const char* name) {
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, name) == 0) {
+			return cconf->values.items[i];
+		}
+	}
+
+	return NULL;
+}
+
+// Same as a reload after the file changed
+void reload(CConfSnapshots* snapshots, const char* filepath, int64_t limit) {
+	CConfFile cconf = cconf_init();
+
+	assert(cconf_load(&cconf, filepath, handler, NULL) == CCONF_STATUS_OK);
+	((CConfField*)find(&cconf, "limit"))->as.num = limit;
+	assert(cconf_snapshot_publish(snapshots, &cconf) == CCONF_STATUS_OK);
+	assert(cconf.values.items == NULL);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfSnapshots snapshots;
+	cconf_snapshots_init(&snapshots);
+	assert(cconf_snapshot_get(&snapshots) == NULL);
+
+	reload(&snapshots, argv[1], 10);
+
+	size_t first = cconf_snapshot_register(&snapshots);
+	size_t second = cconf_snapshot_register(&snapshots);
+	printf("readers %d %d\n", (int)first, (int)second);
+
+	const CConfFile* old = cconf_snapshot_get(&snapshots);
+	printf("limit %d\n", (int)find(old, "limit")->as.num);
+
+	// Both readers might still be using the old snapshot
+	reload(&snapshots, argv[1], 20);
+	printf("limit %d (old %d)\n", (int)find(cconf_snapshot_get(&snapshots), "limit")->as.num, (int)find(old, "limit")->as.num);
+	printf("retired %d\n", (int)cconf_snapshot_reclaim(&snapshots));
+
+	cconf_snapshot_quiescent(&snapshots, first);
+	printf("retired %d\n", (int)cconf_snapshot_reclaim(&snapshots));
+
+	cconf_snapshot_offline(&snapshots, second);
+	printf("retired %d\n", (int)cconf_snapshot_reclaim(&snapshots));
+
+	// Readers that passed a quiescent point only hold the newer snapshots
+	reload(&snapshots, argv[1], 30);
+	reload(&snapshots, argv[1], 40);
+	printf("retired %d\n", (int)cconf_snapshot_reclaim(&snapshots));
+
+	cconf_snapshot_quiescent(&snapshots, first);
+	printf("retired %d\n", (int)cconf_snapshot_reclaim(&snapshots));
+	printf("limit %d\n", (int)find(cconf_snapshot_get(&snapshots), "limit")->as.num);
+
+	cconf_snapshot_unregister(&snapshots, first);
+	cconf_snapshot_unregister(&snapshots, second);
+	printf("readers %d\n", (int)cconf_snapshot_register(&snapshots));
+
+	cconf_snapshots_free(&snapshots);
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	CConfField** fields = (CConfField**)user;
+	size_t i = 0;
+
+	while (fields[i] != NULL) {
+		i++;
+	}
+
+	fields[i] = field;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfField* fields[5] = { 0 };
+	CConfFile cconf = cconf_init();
+	char buf[16];
+	size_t len;
+
+	if (cconf_load(&cconf, argv[1], handler, fields) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	CConfField* threshold = fields[0];
+	CConfField* ratio = fields[1];
+	CConfField* enabled = fields[2];
+	CConfField* motd = fields[3];
+
+	printf(
+		"%lld %.2f %d gen %u\n",
+		(long long)cconf_field_number(threshold),
+		cconf_field_decimal(ratio),
+		cconf_field_boolean(enabled),
+		cconf_field_generation(threshold)
+	);
+
+	// Scalar updates are visible through the getters and mark the field dirty
+	uint32_t seen = cconf_field_generation(threshold);
+	cconf_field_set_number(threshold, 25);
+	cconf_field_set_decimal(ratio, 1.5);
+	cconf_field_set_boolean(enabled, true);
+
+	printf(
+		"%lld %.2f %d changed %d dirty %d%d%d\n",
+		(long long)cconf_field_number(threshold),
+		cconf_field_decimal(ratio),
+		cconf_field_boolean(enabled),
+		cconf_field_generation(threshold) != seen,
+		threshold->dirty, ratio->dirty, enabled->dirty
+	);
+
+	// A string that is being copied is kept until the copy is done
+	motd->readers = 1;
+	cconf_field_set_string(&cconf, motd, "maintenance", 11);
+	printf("retired %zu gen %u\n", cconf.retired.count, cconf_field_generation(motd));
+
+	motd->readers = 0;
+	cconf_field_set_string(&cconf, motd, "welcome back", 12);
+	printf("retired %zu gen %u\n", cconf.retired.count, cconf_field_generation(motd));
+
+	len = cconf_field_string(motd, buf, 4);
+	printf("%zu %.4s\n", len, buf);
+	len = cconf_field_string(motd, buf, sizeof(buf));
+	printf("%zu %.*s\n", len, (int)len, buf);
+
+	// A string replaced during a read is freed by the next write
+	motd->readers = 1;
+	cconf_field_set_string(&cconf, motd, "bye", 3);
+	motd->readers = 0;
+
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	printf("retired %zu dirty %d\n", cconf.retired.count, motd->dirty);
+	dump(argv[1]);
+
+	// A reload frees the strings still being read along with their fields
+	motd->readers = 1;
+	cconf_field_set_string(&cconf, motd, "bye", 3);
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	printf("retired %zu\n", cconf.retired.count);
+
+	memset(fields, 0, sizeof(fields));
+	assert(cconf_reload(&cconf, handler, fields) == CCONF_STATUS_OK);
+	printf("retired %zu %s\n", cconf.retired.count, fields[3]->fieldname);
+
+	cconf_free(&cconf);
+	return 0;
+}
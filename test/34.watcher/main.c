@@ -0,0 +1,101 @@
+#define _POSIX_C_SOURCE 200809L
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+int reloads = 0;
+
+void reload(CConfFile* cconf, const char* filepath, CCONF_STATUS status, void* user) {
+	(void)user;
+	reloads++;
+
+	printf("reload %s status %d", strrchr(filepath, '/') + 1, status);
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		if (strcmp(cconf->values.items[i]->fieldname, "value") == 0) {
+			printf(" value %lld", (long long)cconf->values.items[i]->as.num);
+		}
+	}
+
+	putchar('\n');
+	cconf_free(cconf);
+}
+
+void put(const char* filepath, const char* text) {
+	FILE* f = fopen(filepath, "w");
+	assert(f != NULL);
+	fputs(text, f);
+	fclose(f);
+}
+
+// Handles the events like an external event loop, until `count` reloads
+// happened or `ms` milliseconds passed
+void wait_reloads(CConfWatcher* watcher, int count, int ms) {
+	struct pollfd pfd = { 0 };
+	int timeout = -1;
+	int64_t end = _cconf_now() + ms;
+
+	pfd.fd = watcher->fd;
+	pfd.events = POLLIN;
+
+	while (reloads < count && _cconf_now() < end) {
+		int left = (int)(end - _cconf_now());
+		poll(&pfd, 1, timeout < 0 || timeout > left ? left : timeout);
+		assert(cconf_watcher_process(watcher, &timeout) == CCONF_STATUS_OK);
+	}
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfWatcher watcher;
+	char path[4096];
+	int timeout;
+
+	assert(cconf_watcher_init(&watcher, reload, NULL) == CCONF_STATUS_OK);
+	assert(cconf_watcher_add(&watcher, argv[1]) == CCONF_STATUS_OK);
+
+	assert(cconf_watcher_process(&watcher, &timeout) == CCONF_STATUS_OK);
+	printf("timeout %d reloads %d\n", timeout, reloads);
+
+	// A burst of writes is reloaded once
+	put(argv[1], "value = 2\n");
+	put(argv[1], "value = 3\n");
+	put(argv[1], "# Reloaded on change\nvalue = 4\n");
+	wait_reloads(&watcher, 2, 200);
+	printf("reloads %d\n", reloads);
+
+	// Replacing the file with a rename
+	snprintf(path, sizeof(path), "%s.tmp", argv[1]);
+	put(path, "# Replaced\nvalue = 5\n");
+	assert(rename(path, argv[1]) == 0);
+	wait_reloads(&watcher, 2, 1000);
+	printf("reloads %d\n", reloads);
+
+	// Other files of the same directory are ignored
+	snprintf(path, sizeof(path), "%s.other", argv[1]);
+	put(path, "value = 6\n");
+	wait_reloads(&watcher, 3, 200);
+	remove(path);
+	printf("reloads %d\n", reloads);
+
+	// Syntax errors are reported instead of exiting
+	put(argv[1], "value = = 7\n");
+	wait_reloads(&watcher, 3, 1000);
+
+	put(argv[1], "# Fixed\nvalue = 8\n");
+	wait_reloads(&watcher, 4, 1000);
+	printf("reloads %d\n", reloads);
+
+	// A stopped watcher returns right away
+	cconf_watcher_stop(&watcher);
+	assert(cconf_watcher_run(&watcher) == CCONF_STATUS_OK);
+
+	cconf_watcher_free(&watcher);
+	return 0;
+}
@@ -0,0 +1,129 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+size_t parsed = 0;
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+	parsed++;
+}
+
+void put(const char* filepath, const char* text) {
+	FILE* f = fopen(filepath, "w");
+	assert(f != NULL);
+	fputs(text, f);
+	fclose(f);
+}
+
+// The fields must match the ones of a fresh load of the file
+bool same(CConfFile* cconf) {
+	CConfFile fresh = cconf_init();
+	bool res;
+
+	assert(cconf_load(&fresh, cconf->filepath, handler, NULL) == CCONF_STATUS_OK);
+	res = fresh.values.count == cconf->values.count && fresh.lines == cconf->lines;
+
+	for (size_t i = 0; res && i < fresh.values.count; i++) {
+		CConfField* x = fresh.values.items[i];
+		CConfField* y = cconf->values.items[i];
+
+		res = strcmp(x->fieldname, y->fieldname) == 0 &&
+			x->type == y->type && y->pos == i &&
+			x->start == y->start && x->end == y->end &&
+			x->startl == y->startl && x->endl == y->endl &&
+			memcmp(&x->value, &y->value, sizeof(CConfSpan)) == 0;
+	}
+
+	cconf_free(&fresh);
+	return res;
+}
+
+void reload(CConfFile* cconf, const char* text) {
+	CConfField* before[16] = { 0 };
+	size_t count = cconf->values.count;
+
+	memcpy(before, cconf->values.items, count * sizeof(CConfField*));
+	put(cconf->filepath, text);
+	parsed = 0;
+
+	CCONF_STATUS status = cconf_reload(cconf, handler, NULL);
+	printf("status %d parsed %zu", status, parsed);
+	printf(" same %d kept", status == CCONF_STATUS_OK && same(cconf));
+
+	for (size_t i = 0; i < cconf->values.count; i++) {
+		bool kept = false;
+
+		for (size_t j = 0; j < count; j++) {
+			kept |= before[j] == cconf->values.items[i];
+		}
+
+		printf(" %s%s", cconf->values.items[i]->fieldname, kept ? "" : "*");
+	}
+
+	putchar('\n');
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	CConfFile cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_KEEP_BUFFER | CCONF_FLAG_NO_EXIT;
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	// A changed value
+	reload(&cconf,
+		"# Shared configuration\nalpha = 1\nbeta = \"three\" # second\n\n"
+		"weights = [\n\t1.5, 2.5,\n\t3.5\n]\n\n# Last ones\ngamma = true\ndelta = 4\n");
+
+	// A changed comment between two fields
+	reload(&cconf,
+		"# Shared configuration\nalpha = 1\nbeta = \"three\" # second\n\n"
+		"weights = [\n\t1.5, 2.5,\n\t3.5\n]\n\n# The last fields\n# of the file\ngamma = true\ndelta = 4\n");
+
+	// An element inside a multiline array, and an inserted field
+	reload(&cconf,
+		"# Shared configuration\nalpha = 1\nbeta = \"three\" # second\n\n"
+		"weights = [\n\t1.5, 2.75,\n\t3.5\n]\nepsilon = 5\n\n# The last fields\n# of the file\ngamma = true\ndelta = 4\n");
+
+	// A removed field
+	reload(&cconf,
+		"# Shared configuration\nbeta = \"three\" # second\n\n"
+		"weights = [\n\t1.5, 2.75,\n\t3.5\n]\nepsilon = 5\n\n# The last fields\n# of the file\ngamma = true\ndelta = 4\n");
+
+	// A field appended to the end
+	reload(&cconf,
+		"# Shared configuration\nbeta = \"three\" # second\n\n"
+		"weights = [\n\t1.5, 2.75,\n\t3.5\n]\nepsilon = 5\n\n# The last fields\n# of the file\ngamma = true\ndelta = 4\nzeta = 6\n");
+
+	// Nothing changed
+	reload(&cconf,
+		"# Shared configuration\nbeta = \"three\" # second\n\n"
+		"weights = [\n\t1.5, 2.75,\n\t3.5\n]\nepsilon = 5\n\n# The last fields\n# of the file\ngamma = true\ndelta = 4\nzeta = 6\n");
+
+	// Changes that were not written are discarded by a whole reload
+	cconf.values.items[0]->dirty = true;
+	reload(&cconf,
+		"# Shared configuration\nbeta = \"four\" # second\n\n"
+		"weights = [\n\t1.5, 2.75,\n\t3.5\n]\nepsilon = 5\n\n# The last fields\n# of the file\ngamma = true\ndelta = 4\nzeta = 6\n");
+
+	// Syntax errors make the whole file be parsed again
+	reload(&cconf, "beta = \"four\"\nweights = [1.5,\n");
+	reload(&cconf, "beta = \"four\"\nweights = [1.5]\n");
+	reload(&cconf, "beta = \"four\"\nweights = [1.5, 2.5]\n");
+
+	printf("%s = %.*s\n", cconf.values.items[0]->fieldname,
+		(int)CCONF_STRING_SIZE(cconf.values.items[0]->as.str), cconf.values.items[0]->as.str);
+
+	cconf_free(&cconf);
+	return 0;
+}
@@ -0,0 +1,66 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)user;
+	printf("%s type %d lines %" PRId64 "-%" PRId64 "\n", field->fieldname, field->type, field->startl, field->endl);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	// The last number is not followed by a newline
+	CConfFile cconf = cconf_init();
+
+	assert(cconf_load(&cconf, argv[1], handler, NULL) == CCONF_STATUS_OK);
+	assert(cconf.values.count == 3);
+	assert(cconf.values.items[0]->as.num == 5);
+	assert(cconf.values.items[1]->as.dec == -2.25);
+	assert(cconf.values.items[2]->as.num == 22);
+	cconf_free(&cconf);
+
+	const char* keys[] = { "last" };
+	cconf = cconf_init();
+
+	assert(cconf_load_keys(&cconf, argv[1], keys, 1, handler, NULL) == CCONF_STATUS_OK);
+	assert(cconf.values.count == 1);
+	assert(cconf.values.items[0]->as.num == 22);
+	cconf_free(&cconf);
+
+	// Buffers are not NUL-terminated either
+	const char* inputs[] = { "a = 5\nb = 22", "a = -7", "a = 1.5", "a = [1, 22" };
+
+	for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+		size_t len = strlen(inputs[i]);
+		char* data = (char*)malloc(len);
+		CConfReader reader;
+		CConfField field;
+		CCONF_STATUS status;
+
+		memcpy(data, inputs[i], len);
+		cconf_reader_open_buffer(&reader, data, len);
+
+		while ((status = cconf_reader_next(&reader, &field)) == CCONF_STATUS_OK) {
+			if (field.type == CCONF_TYPE_NUMBER) {
+				printf("%s = %" PRId64 "\n", field.fieldname, field.as.num);
+			}
+			else {
+				printf("%s = %.2f\n", field.fieldname, field.as.dec);
+			}
+
+			cconf_field_clear(&field);
+		}
+
+		printf("status %d\n", status);
+		cconf_reader_close(&reader);
+		free(data);
+	}
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+#define CCONF_IMPLEMENTATION
+#include "cconfig.h"
+#include <locale.h>
+#include <assert.h>
+
+void handler(CConfField* field, void* user) {
+	(void)field;
+	(void)user;
+}
+
+void dump(const char* filepath) {
+	size_t len;
+	char* data;
+
+	assert(_cconf_read_entire_file(filepath, &len, &data) == CCONF_STATUS_OK);
+	printf("%.*s--\n", (int)len, data);
+	free(data);
+}
+
+int main(int argc, const char *argv[]) {
+	if (argc < 2) {
+		return 1;
+	}
+
+	setlocale(LC_NUMERIC, "C");
+
+	// Strict C99 builds do not declare mkstemp() and fsync(), so atomic
+	// writes are refused instead of silently rewriting the file in place
+	CConfFile cconf = cconf_init();
+	cconf.flags = CCONF_FLAG_ATOMIC_WRITE;
+	cconf.commit_threshold = 3;
+
+	if (cconf_load(&cconf, argv[1], handler, NULL) != CCONF_STATUS_OK) {
+		return 2;
+	}
+
+	cconf.values.items[0]->as.num = 10;
+	cconf.values.items[0]->dirty = true;
+	assert(cconf_write(&cconf) == CCONF_STATUS_UNSUPPORTED);
+	assert(cconf_flush(&cconf) == CCONF_STATUS_UNSUPPORTED);
+	dump(argv[1]);
+
+	// Without the flag the file is written as usual
+	cconf.flags = 0;
+	cconf.commit_threshold = 0;
+	assert(cconf_write(&cconf) == CCONF_STATUS_OK);
+	dump(argv[1]);
+
+	cconf_free(&cconf);
+
+	return 0;
+}